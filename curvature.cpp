@@ -1,91 +1,251 @@
 #include "curvature.h"
 
+#include "core/io/marshalls.h"
+#include "core/os/os.h"
+#include "core/os/thread.h"
 #include "core/math/math_funcs.h"
-#include <chrono>
+#include "core/templates/local_vector.h"
+#include "curvature_bake_scheduler.h"
+#include "curvature_cache_interner.h"
+#include "curvature_stats.h"
 #include <mutex>
-#include <shared_mutex>
 
 const char *BetterCurve::SIGNAL_RANGE_CHANGED = "range_changed";
 const char *BetterCurve::SIGNAL_BAKED = "baked";
 
+// Index of the last of p_count sorted offsets at or before p_x, 0 if there's none.
+// The search range halves without branching on the comparison, so it compiles to conditional moves.
+static _FORCE_INLINE_ int find_last_at_or_before(const real_t *p_xs, int p_count, real_t p_x) {
+	int base = 0;
+	int count = p_count;
+	while (count > 1) {
+		const int half = count / 2;
+		base = p_xs[base + half] <= p_x ? base + half : base;
+		count -= half;
+	}
+	return base;
+}
+
+// Like CLAMP, but NaN gives p_min instead of passing through, so the result can be cast to an index.
+static _FORCE_INLINE_ real_t clamp_to_index_range(real_t p_value, real_t p_min, real_t p_max) {
+	return p_value >= p_min ? MIN(p_value, p_max) : p_min;
+}
+
+void BetterCurve::Points::resize(int p_size) {
+	x.resize(p_size);
+	y.resize(p_size);
+	left_tangent.resize(p_size);
+	right_tangent.resize(p_size);
+	modes.resize(p_size);
+}
+
+BetterCurve::Point BetterCurve::Points::get(int p_index) const {
+	return Point(get_position(p_index), left_tangent[p_index], right_tangent[p_index], get_left_mode(p_index), get_right_mode(p_index));
+}
+
+void BetterCurve::Points::set(int p_index, const Point &p_point) {
+	x.write[p_index] = p_point.position.x;
+	y.write[p_index] = p_point.position.y;
+	left_tangent.write[p_index] = p_point.left_tangent;
+	right_tangent.write[p_index] = p_point.right_tangent;
+	modes.write[p_index] = p_point.left_mode | (p_point.right_mode << 4);
+}
+
+void BetterCurve::Points::insert(int p_index, const Point &p_point) {
+	x.insert(p_index, p_point.position.x);
+	y.insert(p_index, p_point.position.y);
+	left_tangent.insert(p_index, p_point.left_tangent);
+	right_tangent.insert(p_index, p_point.right_tangent);
+	modes.insert(p_index, p_point.left_mode | (p_point.right_mode << 4));
+}
+
+void BetterCurve::Points::remove_at(int p_index) {
+	x.remove_at(p_index);
+	y.remove_at(p_index);
+	left_tangent.remove_at(p_index);
+	right_tangent.remove_at(p_index);
+	modes.remove_at(p_index);
+}
+
 BetterCurve::BetterCurve() {
+	BetterCurveStats::curve_created();
 }
 
 BetterCurve::~BetterCurve() {
-	if (_update_thread.is_started()) {
-		_update_thread.wait_to_finish();
+	BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+	if (scheduler) {
+		scheduler->cancel(this);
 	}
+	BetterCurveStats::curve_destroyed();
 }
 
 void BetterCurve::set_point_count(int p_count) {
 	ERR_FAIL_COND(p_count < 0);
-	int old_size = _points.size();
-	if (old_size == p_count) {
-		return;
-	}
-
 	{
+		// The count is compared and changed in one locked step, other edits may resize the curve as well.
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		const int old_size = _points.size();
+		if (old_size == p_count) {
+			return;
+		}
 		if (old_size > p_count) {
+			_mark_dirty();
 			_points.resize(p_count);
 		} else {
 			for (int i = p_count - old_size; i > 0; i--) {
-				_add_point(Vector2());
+				_insert_point(Point(Vector2()));
 			}
 		}
 	}
 
 	_queue_update();
-	notify_property_list_changed();
+	_notify_point_count_changed();
 }
 
-int BetterCurve::_add_point(Vector2 p_position, real_t p_left_tangent, real_t p_right_tangent, TangentMode p_left_mode, TangentMode p_right_mode) {
-	int ret = -1;
+void BetterCurve::begin_edit() {
+	std::unique_lock<std::mutex> lock(_update_param_mutex);
+	++_edit_depth;
+}
+
+void BetterCurve::commit_edit() {
+	bool update_pending = false;
+	bool point_count_pending = false;
+	{
+		// The depth and the pending flags are checked and changed together, so no deferred edit is lost in between.
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		ERR_FAIL_COND_MSG(_edit_depth == 0, "commit_edit() called without a matching begin_edit().");
+		if (--_edit_depth > 0) {
+			return;
+		}
+		update_pending = _edit_update_pending;
+		point_count_pending = _edit_point_count_pending;
+		_edit_update_pending = false;
+		_edit_point_count_pending = false;
+	}
+
+	if (update_pending) {
+		_queue_update();
+	}
+	if (point_count_pending) {
+		notify_property_list_changed();
+	}
+}
+
+void BetterCurve::_notify_point_count_changed() {
 	{
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		if (_edit_depth > 0) {
+			_edit_point_count_pending = true;
+			return;
+		}
+	}
+	notify_property_list_changed();
+}
 
-		// Add a point and preserve order
+void BetterCurve::set_points(const PackedVector2Array &p_positions, const PackedFloat32Array &p_left_tangents, const PackedFloat32Array &p_right_tangents, const PackedInt32Array &p_left_modes, const PackedInt32Array &p_right_modes) {
+	const int count = p_positions.size();
+	ERR_FAIL_COND_MSG(!p_left_tangents.is_empty() && p_left_tangents.size() != count, "Left tangents must be empty or match the number of positions.");
+	ERR_FAIL_COND_MSG(!p_right_tangents.is_empty() && p_right_tangents.size() != count, "Right tangents must be empty or match the number of positions.");
+	ERR_FAIL_COND_MSG(!p_left_modes.is_empty() && p_left_modes.size() != count, "Left modes must be empty or match the number of positions.");
+	ERR_FAIL_COND_MSG(!p_right_modes.is_empty() && p_right_modes.size() != count, "Right modes must be empty or match the number of positions.");
+
+	Vector<Point> points;
+	points.resize(count);
+	Point *pw = points.ptrw();
+	for (int i = 0; i < count; ++i) {
+		int left_mode = p_left_modes.is_empty() ? TANGENT_FREE : p_left_modes[i];
+		int right_mode = p_right_modes.is_empty() ? TANGENT_FREE : p_right_modes[i];
+		ERR_FAIL_COND(left_mode < 0 || left_mode >= TANGENT_MODE_COUNT);
+		ERR_FAIL_COND(right_mode < 0 || right_mode >= TANGENT_MODE_COUNT);
 
 		// Curve bounds is in 0..1
-		if (p_position.x > MAX_X) {
-			p_position.x = MAX_X;
-		} else if (p_position.x < MIN_X) {
-			p_position.x = MIN_X;
+		Vector2 position = p_positions[i];
+		position.x = CLAMP(position.x, (real_t)MIN_X, (real_t)MAX_X);
+		pw[i] = Point(position,
+				p_left_tangents.is_empty() ? 0.0 : p_left_tangents[i],
+				p_right_tangents.is_empty() ? 0.0 : p_right_tangents[i],
+				(TangentMode)left_mode,
+				(TangentMode)right_mode);
+	}
+
+	struct PointOffsetComparator {
+		_FORCE_INLINE_ bool operator()(const Point &p_a, const Point &p_b) const { return p_a.position.x < p_b.position.x; }
+	};
+	points.sort_custom<PointOffsetComparator>();
+
+	int old_size = 0;
+	{
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		old_size = _points.size();
+		_mark_dirty();
+		_points.resize(count);
+		for (int i = 0; i < count; ++i) {
+			_points.set(i, points[i]);
+		}
+		for (int i = 0; i < count; ++i) {
+			update_auto_tangents(i);
 		}
+	}
 
-		if (_points.size() == 0) {
-			_points.push_back(Point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode));
-			ret = 0;
+	_queue_update();
+	if (old_size != count) {
+		_notify_point_count_changed();
+	}
+}
 
-		} else if (_points.size() == 1) {
-			// TODO Is the `else` able to handle this block already?
+int BetterCurve::_insert_point(Point p_point) {
+	// Add a point and preserve order
 
-			real_t diff = p_position.x - _points[0].position.x;
+	// Curve bounds is in 0..1
+	if (p_point.position.x > MAX_X) {
+		p_point.position.x = MAX_X;
+	} else if (p_point.position.x < MIN_X) {
+		p_point.position.x = MIN_X;
+	}
 
-			if (diff > 0) {
-				_points.push_back(Point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode));
-				ret = 1;
-			} else {
-				_points.insert(0, Point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode));
-				ret = 0;
-			}
+	int ret = -1;
+	if (_points.size() == 0) {
+		_points.insert(_points.size(), p_point);
+		ret = 0;
+
+	} else if (_points.size() == 1) {
+		// TODO Is the `else` able to handle this block already?
 
+		real_t diff = p_point.position.x - _points.x[0];
+
+		if (diff > 0) {
+			_points.insert(_points.size(), p_point);
+			ret = 1;
 		} else {
-			int i = get_index(p_position.x);
-
-			if (i == 0 && p_position.x < _points[0].position.x) {
-				// Insert before anything else
-				_points.insert(0, Point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode));
-				ret = 0;
-			} else {
-				// Insert between i and i+1
-				++i;
-				_points.insert(i, Point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode));
-				ret = i;
-			}
+			_points.insert(0, p_point);
+			ret = 0;
+		}
+
+	} else {
+		int i = get_index(p_point.position.x);
+
+		if (i == 0 && p_point.position.x < _points.x[0]) {
+			// Insert before anything else
+			_points.insert(0, p_point);
+			ret = 0;
+		} else {
+			// Insert between i and i+1
+			++i;
+			_points.insert(i, p_point);
+			ret = i;
 		}
+	}
+
+	update_auto_tangents(ret);
+	_mark_point_dirty(ret);
+	return ret;
+}
 
-		update_auto_tangents(ret);
+int BetterCurve::_add_point(Vector2 p_position, real_t p_left_tangent, real_t p_right_tangent, TangentMode p_left_mode, TangentMode p_right_mode) {
+	int ret = -1;
+	{
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		ret = _insert_point(Point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode));
 	}
 
 	_queue_update();
@@ -95,7 +255,7 @@ int BetterCurve::_add_point(Vector2 p_position, real_t p_left_tangent, real_t p_
 
 int BetterCurve::add_point(Vector2 p_position, real_t p_left_tangent, real_t p_right_tangent, TangentMode p_left_mode, TangentMode p_right_mode) {
 	int ret = _add_point(p_position, p_left_tangent, p_right_tangent, p_left_mode, p_right_mode);
-	notify_property_list_changed();
+	_notify_point_count_changed();
 
 	return ret;
 }
@@ -108,33 +268,8 @@ int BetterCurve::add_point_no_update(Vector2 p_position, real_t p_left_tangent,
 }
 
 int BetterCurve::get_index(real_t p_offset) const {
-	// Lower-bound float binary search
-
-	int imin = 0;
-	int imax = _points.size() - 1;
-
-	while (imax - imin > 1) {
-		int m = (imin + imax) / 2;
-
-		real_t a = _points[m].position.x;
-		real_t b = _points[m + 1].position.x;
-
-		if (a < p_offset && b < p_offset) {
-			imin = m;
-
-		} else if (a > p_offset) {
-			imax = m;
-
-		} else {
-			return m;
-		}
-	}
-
-	// Will happen if the offset is out of bounds
-	if (p_offset > _points[imax].position.x) {
-		return imax;
-	}
-	return imin;
+	// Lower-bound float binary search, over the offsets only.
+	return find_last_at_or_before(_points.x.ptr(), _points.size(), p_offset);
 }
 
 void BetterCurve::clean_dupes() {
@@ -142,13 +277,22 @@ void BetterCurve::clean_dupes() {
 	{
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
-		for (int i = 1; i < _points.size(); ++i) {
-			real_t diff = _points[i - 1].position.x - _points[i].position.x;
-			if (diff <= CMP_EPSILON) {
-				_points.remove_at(i);
-				--i;
+		// Compacted in a single pass, keeping the first point of each run of duplicates.
+		const int count = _points.size();
+		int kept = MIN(count, 1);
+		for (int i = 1; i < count; ++i) {
+			if (_points.x[i] - _points.x[kept - 1] <= CMP_EPSILON) {
 				dirty = true;
+				continue;
 			}
+			if (kept != i) {
+				_points.set(kept, _points.get(i));
+			}
+			++kept;
+		}
+		if (dirty) {
+			_mark_dirty();
+			_points.resize(kept);
 		}
 	}
 
@@ -162,8 +306,9 @@ void BetterCurve::set_point_left_tangent(int p_index, real_t p_tangent) {
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
 		ERR_FAIL_INDEX(p_index, _points.size());
-		_points.write[p_index].left_tangent = p_tangent;
-		_points.write[p_index].left_mode = TANGENT_FREE;
+		_mark_point_dirty(p_index);
+		_points.left_tangent.write[p_index] = p_tangent;
+		_points.set_left_mode(p_index, TANGENT_FREE);
 	}
 	_queue_update();
 }
@@ -173,8 +318,9 @@ void BetterCurve::set_point_right_tangent(int p_index, real_t p_tangent) {
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
 		ERR_FAIL_INDEX(p_index, _points.size());
-		_points.write[p_index].right_tangent = p_tangent;
-		_points.write[p_index].right_mode = TANGENT_FREE;
+		_mark_point_dirty(p_index);
+		_points.right_tangent.write[p_index] = p_tangent;
+		_points.set_right_mode(p_index, TANGENT_FREE);
 	}
 	_queue_update();
 }
@@ -184,11 +330,12 @@ void BetterCurve::set_point_left_mode(int p_index, TangentMode p_mode) {
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
 		ERR_FAIL_INDEX(p_index, _points.size());
-		_points.write[p_index].left_mode = p_mode;
+		_mark_point_dirty(p_index);
+		_points.set_left_mode(p_index, p_mode);
 		if (p_index > 0) {
 			if (p_mode == TANGENT_LINEAR) {
-				Vector2 v = (_points[p_index - 1].position - _points[p_index].position).normalized();
-				_points.write[p_index].left_tangent = v.y / v.x;
+				Vector2 v = (_points.get_position(p_index - 1) - _points.get_position(p_index)).normalized();
+				_points.left_tangent.write[p_index] = v.y / v.x;
 			}
 		}
 	}
@@ -200,11 +347,12 @@ void BetterCurve::set_point_right_mode(int p_index, TangentMode p_mode) {
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
 		ERR_FAIL_INDEX(p_index, _points.size());
-		_points.write[p_index].right_mode = p_mode;
+		_mark_point_dirty(p_index);
+		_points.set_right_mode(p_index, p_mode);
 		if (p_index + 1 < _points.size()) {
 			if (p_mode == TANGENT_LINEAR) {
-				Vector2 v = (_points[p_index + 1].position - _points[p_index].position).normalized();
-				_points.write[p_index].right_tangent = v.y / v.x;
+				Vector2 v = (_points.get_position(p_index + 1) - _points.get_position(p_index)).normalized();
+				_points.right_tangent.write[p_index] = v.y / v.x;
 			}
 		}
 	}
@@ -213,22 +361,22 @@ void BetterCurve::set_point_right_mode(int p_index, TangentMode p_mode) {
 
 real_t BetterCurve::get_point_left_tangent(int p_index) const {
 	ERR_FAIL_INDEX_V(p_index, _points.size(), 0);
-	return _points[p_index].left_tangent;
+	return _points.left_tangent[p_index];
 }
 
 real_t BetterCurve::get_point_right_tangent(int p_index) const {
 	ERR_FAIL_INDEX_V(p_index, _points.size(), 0);
-	return _points[p_index].right_tangent;
+	return _points.right_tangent[p_index];
 }
 
 BetterCurve::TangentMode BetterCurve::get_point_left_mode(int p_index) const {
 	ERR_FAIL_INDEX_V(p_index, _points.size(), TANGENT_FREE);
-	return _points[p_index].left_mode;
+	return _points.get_left_mode(p_index);
 }
 
 BetterCurve::TangentMode BetterCurve::get_point_right_mode(int p_index) const {
 	ERR_FAIL_INDEX_V(p_index, _points.size(), TANGENT_FREE);
-	return _points[p_index].right_mode;
+	return _points.get_right_mode(p_index);
 }
 
 void BetterCurve::_remove_point(int p_index) {
@@ -236,6 +384,7 @@ void BetterCurve::_remove_point(int p_index) {
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
 		ERR_FAIL_INDEX(p_index, _points.size());
+		_mark_point_dirty(p_index);
 		_points.remove_at(p_index);
 	}
 	_queue_update();
@@ -243,7 +392,7 @@ void BetterCurve::_remove_point(int p_index) {
 
 void BetterCurve::remove_point(int p_index) {
 	_remove_point(p_index);
-	notify_property_list_changed();
+	_notify_point_count_changed();
 }
 
 void BetterCurve::clear_points() {
@@ -253,10 +402,11 @@ void BetterCurve::clear_points() {
 	{
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
+		_mark_dirty();
 		_points.clear();
 	}
 	_queue_update();
-	notify_property_list_changed();
+	_notify_point_count_changed();
 }
 
 void BetterCurve::set_point_value(int p_index, real_t p_position) {
@@ -264,60 +414,68 @@ void BetterCurve::set_point_value(int p_index, real_t p_position) {
 		std::unique_lock<std::mutex> lock(_update_param_mutex);
 
 		ERR_FAIL_INDEX(p_index, _points.size());
-		_points.write[p_index].position.y = p_position;
+		_mark_point_dirty(p_index);
+		_points.y.write[p_index] = p_position;
 		update_auto_tangents(p_index);
 	}
 	_queue_update();
 }
 
 int BetterCurve::set_point_offset(int p_index, real_t p_offset) {
-	ERR_FAIL_INDEX_V(p_index, _points.size(), -1);
-	Point p = _points[p_index];
-	_remove_point(p_index);
-	int i = _add_point(Vector2(p_offset, p.position.y));
-	_points.write[i].left_tangent = p.left_tangent;
-	_points.write[i].right_tangent = p.right_tangent;
-	_points.write[i].left_mode = p.left_mode;
-	_points.write[i].right_mode = p.right_mode;
-	if (p_index != i) {
-		update_auto_tangents(p_index);
+	int i = -1;
+	{
+		// One locked step, so that no other edit can move the point between its removal and its insertion.
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+
+		ERR_FAIL_INDEX_V(p_index, _points.size(), -1);
+		Point p = _points.get(p_index);
+		_mark_point_dirty(p_index);
+		_points.remove_at(p_index);
+
+		p.position.x = p_offset;
+		i = _insert_point(p);
+		if (p_index != i) {
+			// The point now at the old index took over its neighbours.
+			update_auto_tangents(p_index);
+			_mark_point_dirty(p_index);
+		}
 	}
-	update_auto_tangents(i);
+	_queue_update();
 	return i;
 }
 
 Vector2 BetterCurve::get_point_position(int p_index) const {
 	ERR_FAIL_INDEX_V(p_index, _points.size(), Vector2(0, 0));
-	return _points[p_index].position;
+	return _points.get_position(p_index);
 }
 
 BetterCurve::Point BetterCurve::get_point(int p_index) const {
 	ERR_FAIL_INDEX_V(p_index, _points.size(), Point());
-	return _points[p_index];
+	return _points.get(p_index);
 }
 
 void BetterCurve::update_auto_tangents(int p_index) {
-	Point &p = _points.write[p_index];
+	const Vector2 position = _points.get_position(p_index);
 
 	if (p_index > 0) {
-		if (p.left_mode == TANGENT_LINEAR) {
-			Vector2 v = (_points[p_index - 1].position - p.position).normalized();
-			p.left_tangent = v.y / v.x;
+		if (_points.get_left_mode(p_index) == TANGENT_LINEAR) {
+			Vector2 v = (_points.get_position(p_index - 1) - position).normalized();
+			_points.left_tangent.write[p_index] = v.y / v.x;
 		}
-		if (_points[p_index - 1].right_mode == TANGENT_LINEAR) {
-			Vector2 v = (_points[p_index - 1].position - p.position).normalized();
-			_points.write[p_index - 1].right_tangent = v.y / v.x;
+		if (_points.get_right_mode(p_index - 1) == TANGENT_LINEAR) {
+			Vector2 v = (_points.get_position(p_index - 1) - position).normalized();
+			_points.right_tangent.write[p_index - 1] = v.y / v.x;
 		}
 	}
 
 	if (p_index + 1 < _points.size()) {
-		if (p.right_mode == TANGENT_LINEAR) {
-			Vector2 v = (_points[p_index + 1].position - p.position).normalized();
-			p.right_tangent = v.y / v.x;
+		if (_points.get_right_mode(p_index) == TANGENT_LINEAR) {
+			Vector2 v = (_points.get_position(p_index + 1) - position).normalized();
+			_points.right_tangent.write[p_index] = v.y / v.x;
 		}
-		if (_points[p_index + 1].left_mode == TANGENT_LINEAR) {
-			Vector2 v = (_points[p_index + 1].position - p.position).normalized();
-			_points.write[p_index + 1].left_tangent = v.y / v.x;
+		if (_points.get_left_mode(p_index + 1) == TANGENT_LINEAR) {
+			Vector2 v = (_points.get_position(p_index + 1) - position).normalized();
+			_points.left_tangent.write[p_index + 1] = v.y / v.x;
 		}
 	}
 }
@@ -334,6 +492,10 @@ void BetterCurve::set_min_value(real_t p_min) {
 	// Note: min and max are indicative values,
 	// it's still possible that existing points are out of range at this point.
 	emit_signal(SNAME(SIGNAL_RANGE_CHANGED));
+	// Normalized tables are encoded against the range.
+	if (_bake_precision == BAKE_PRECISION_UNORM16 && !_points.is_empty()) {
+		_queue_update();
+	}
 }
 
 void BetterCurve::set_max_value(real_t p_max) {
@@ -344,6 +506,9 @@ void BetterCurve::set_max_value(real_t p_max) {
 		_max_value = p_max;
 	}
 	emit_signal(SNAME(SIGNAL_RANGE_CHANGED));
+	if (_bake_precision == BAKE_PRECISION_UNORM16 && !_points.is_empty()) {
+		_queue_update();
+	}
 }
 
 real_t BetterCurve::sample(real_t p_offset) const {
@@ -356,7 +521,7 @@ Array BetterCurve::get_data() const {
 	output.resize(_points.size() * ELEMS);
 
 	for (int j = 0; j < _points.size(); ++j) {
-		const Point p = _points[j];
+		const Point p = _points.get(j);
 		int i = j * ELEMS;
 
 		output[i] = p.position;
@@ -393,325 +558,1858 @@ void BetterCurve::set_data(const Array p_input) {
 			ERR_FAIL_COND(right_mode < 0 || right_mode >= TANGENT_MODE_COUNT);
 		}
 		new_size = p_input.size() / ELEMS;
+		_mark_dirty();
 		if (old_size != new_size) {
 			_points.resize(new_size);
 		}
 
 		for (int j = 0; j < _points.size(); ++j) {
-			Point &p = _points.write[j];
 			int i = j * ELEMS;
 
-			p.position = p_input[i];
-			p.left_tangent = p_input[i + 1];
-			p.right_tangent = p_input[i + 2];
 			int left_mode = p_input[i + 3];
 			int right_mode = p_input[i + 4];
-			p.left_mode = (TangentMode)left_mode;
-			p.right_mode = (TangentMode)right_mode;
+			_points.set(j, Point(p_input[i], p_input[i + 1], p_input[i + 2], (TangentMode)left_mode, (TangentMode)right_mode));
 		}
 	}
 
 	_queue_update();
 	if (old_size != new_size) {
-		notify_property_list_changed();
+		_notify_point_count_changed();
 	}
 }
 
-void BetterCurve::bake() {
-	_baked_cache.clear();
+// Layout of _packed_data, all little-endian:
+// u32 version, u32 flags, u32 point count,
+// per point: real x, y, left tangent, right tangent, u8 left mode, u8 right mode,
+// then with PACKED_DATA_BAKED: u32 value count, real values[], and with PACKED_DATA_ADAPTIVE
+// also real offsets[], u32 index count, u32 index[].
+// Reals are 32-bit floats unless PACKED_DATA_DOUBLE is set.
+#define PACKED_DATA_VERSION 1
+#define PACKED_DATA_HEADER_SIZE 12
+
+enum PackedDataFlags {
+	PACKED_DATA_DOUBLE = 1 << 0,
+	PACKED_DATA_BAKED = 1 << 1,
+	PACKED_DATA_ADAPTIVE = 1 << 2,
+};
+
+static _FORCE_INLINE_ int encode_real(real_t p_value, bool p_double, uint8_t *r_ptr) {
+	return p_double ? encode_double(p_value, r_ptr) : encode_float(p_value, r_ptr);
+}
 
-	_baked_cache.resize(_bake_resolution);
+static _FORCE_INLINE_ real_t decode_real(bool p_double, const uint8_t *p_ptr) {
+	return p_double ? decode_double(p_ptr) : decode_float(p_ptr);
+}
 
-	for (int i = 1; i < _bake_resolution - 1; ++i) {
-		real_t x = i / static_cast<real_t>(_bake_resolution - 1);
-		real_t y = sample(x);
-		_baked_cache.write[i] = y;
+PackedByteArray BetterCurve::get_packed_data() const {
+#ifdef REAL_T_IS_DOUBLE
+	const bool use_double = true;
+#else
+	const bool use_double = false;
+#endif
+	const int real_size = use_double ? 8 : 4;
+	const int point_count = _points.size();
+
+	// Baked from the current segments rather than taken from the published table, which may lag behind.
+	BakedCacheRef cache;
+	if (_store_baked_cache) {
+		SegmentsRef segments = get_segments();
+		if (!segments) {
+			segments = _build_segments(_points);
+		}
+		cache = _bake_tolerance > 0 ? _bake_segments_adaptive(*segments, _bake_tolerance) : _bake_segments(*segments, _bake_resolution);
 	}
 
-	if (_points.size() != 0) {
-		_baked_cache.write[0] = _points[0].position.y;
-		_baked_cache.write[_baked_cache.size() - 1] = _points[_points.size() - 1].position.y;
+	uint32_t flags = use_double ? PACKED_DATA_DOUBLE : 0;
+	int size = PACKED_DATA_HEADER_SIZE + point_count * (4 * real_size + 2);
+	if (cache) {
+		flags |= PACKED_DATA_BAKED;
+		size += 4 + cache->values.size() * real_size;
+		if (cache->is_adaptive()) {
+			flags |= PACKED_DATA_ADAPTIVE;
+			size += cache->offsets.size() * real_size + 4 + cache->index.size() * 4;
+		}
 	}
 
-	_baked_cache_dirty = false;
-}
+	PackedByteArray output;
+	output.resize(size);
+	uint8_t *w = output.ptrw();
+
+	w += encode_uint32(PACKED_DATA_VERSION, w);
+	w += encode_uint32(flags, w);
+	w += encode_uint32(point_count, w);
+	for (int i = 0; i < point_count; ++i) {
+		const Point p = _points.get(i);
+		w += encode_real(p.position.x, use_double, w);
+		w += encode_real(p.position.y, use_double, w);
+		w += encode_real(p.left_tangent, use_double, w);
+		w += encode_real(p.right_tangent, use_double, w);
+		*w++ = p.left_mode;
+		*w++ = p.right_mode;
+	}
 
-void BetterCurve::set_bake_resolution(int p_resolution) {
-	ERR_FAIL_COND(p_resolution < 1);
-	ERR_FAIL_COND(p_resolution > 1000);
-	_bake_resolution = p_resolution;
-	_baked_cache_dirty = true;
+	if (cache) {
+		w += encode_uint32(cache->values.size(), w);
+		for (int i = 0; i < cache->values.size(); ++i) {
+			w += encode_real(cache->values[i], use_double, w);
+		}
+		if (cache->is_adaptive()) {
+			for (int i = 0; i < cache->offsets.size(); ++i) {
+				w += encode_real(cache->offsets[i], use_double, w);
+			}
+			w += encode_uint32(cache->index.size(), w);
+			for (int i = 0; i < cache->index.size(); ++i) {
+				w += encode_uint32(cache->index[i], w);
+			}
+		}
+	}
+
+	return output;
 }
 
-real_t BetterCurve::sample_baked(real_t p_offset) const {
-	std::shared_lock<std::shared_mutex> lock(*(const_cast<std::shared_mutex *>(&_getter_mutex)));
-	// Special cases if the cache is too small
-	if (_baked_cache.size() == 0) {
-		if (_points.size() == 0) {
-			return 0;
+void BetterCurve::set_packed_data(const PackedByteArray &p_data) {
+	const int size = p_data.size();
+	ERR_FAIL_COND_MSG(size < PACKED_DATA_HEADER_SIZE, "Invalid BetterCurve packed data: truncated header.");
+	const uint8_t *r = p_data.ptr();
+	const uint8_t *end = r + size;
+
+	uint32_t version = decode_uint32(r);
+	ERR_FAIL_COND_MSG(version != PACKED_DATA_VERSION, vformat("Unsupported BetterCurve packed data version %d.", version));
+	uint32_t flags = decode_uint32(r + 4);
+	uint32_t point_count = decode_uint32(r + 8);
+	r += PACKED_DATA_HEADER_SIZE;
+
+	const bool use_double = flags & PACKED_DATA_DOUBLE;
+	const int real_size = use_double ? 8 : 4;
+	ERR_FAIL_COND_MSG(static_cast<uint64_t>(end - r) < static_cast<uint64_t>(point_count) * (4 * real_size + 2), "Invalid BetterCurve packed data: truncated points.");
+
+	Points points;
+	points.resize(point_count);
+	for (uint32_t i = 0; i < point_count; ++i) {
+		Point p;
+		p.position.x = decode_real(use_double, r);
+		p.position.y = decode_real(use_double, r + real_size);
+		p.left_tangent = decode_real(use_double, r + 2 * real_size);
+		p.right_tangent = decode_real(use_double, r + 3 * real_size);
+		r += 4 * real_size;
+		ERR_FAIL_COND_MSG(r[0] >= TANGENT_MODE_COUNT || r[1] >= TANGENT_MODE_COUNT, "Invalid BetterCurve packed data: unknown tangent mode.");
+		p.left_mode = (TangentMode)r[0];
+		p.right_mode = (TangentMode)r[1];
+		r += 2;
+		points.set(i, p);
+	}
+
+	// A stored table is only used if it was baked with the settings the curve has now.
+	std::shared_ptr<BakedCache> cache;
+	if (flags & PACKED_DATA_BAKED) {
+		ERR_FAIL_COND_MSG(end - r < 4, "Invalid BetterCurve packed data: truncated baked cache.");
+		uint32_t value_count = decode_uint32(r);
+		r += 4;
+		const bool adaptive = flags & PACKED_DATA_ADAPTIVE;
+		ERR_FAIL_COND_MSG(static_cast<uint64_t>(end - r) < static_cast<uint64_t>(value_count) * real_size * (adaptive ? 2 : 1), "Invalid BetterCurve packed data: truncated baked cache.");
+
+		cache = std::make_shared<BakedCache>();
+		cache->values.resize(value_count);
+		for (uint32_t i = 0; i < value_count; ++i, r += real_size) {
+			cache->values.write[i] = decode_real(use_double, r);
+		}
+		if (adaptive) {
+			cache->offsets.resize(value_count);
+			for (uint32_t i = 0; i < value_count; ++i, r += real_size) {
+				cache->offsets.write[i] = decode_real(use_double, r);
+			}
+			ERR_FAIL_COND_MSG(end - r < 4, "Invalid BetterCurve packed data: truncated baked index.");
+			uint32_t index_count = decode_uint32(r);
+			r += 4;
+			ERR_FAIL_COND_MSG(static_cast<uint64_t>(end - r) < static_cast<uint64_t>(index_count) * 4, "Invalid BetterCurve packed data: truncated baked index.");
+			cache->index.resize(index_count);
+			for (uint32_t i = 0; i < index_count; ++i, r += 4) {
+				uint32_t value = decode_uint32(r);
+				ERR_FAIL_COND_MSG(value >= value_count, "Invalid BetterCurve packed data: baked index out of range.");
+				cache->index.write[i] = value;
+			}
+			if (value_count < 2 || index_count == 0 || _bake_tolerance <= 0) {
+				cache.reset();
+			}
+		} else if (value_count == 0 || static_cast<int>(value_count) != _bake_resolution || _bake_tolerance > 0) {
+			cache.reset();
 		}
-		return _points[0].position.y;
-	} else if (_baked_cache.size() == 1) {
-		return _baked_cache[0];
 	}
+	// Tables are stored at full precision, whatever the curve keeps in memory.
+	BakedCacheRef loaded_cache = cache ? _quantize_baked_cache(cache, _bake_precision, _min_value, _max_value) : BakedCacheRef();
 
-	// Get interpolation index
-	real_t fi = p_offset * (_baked_cache.size() - 1);
-	int i = Math::floor(fi);
-	if (i < 0) {
-		i = 0;
-		fi = 0;
-	} else if (i >= _baked_cache.size()) {
-		i = _baked_cache.size() - 1;
-		fi = 0;
+	int old_size = 0;
+	{
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		old_size = _points.size();
+		_mark_dirty();
+		_points = points;
 	}
 
-	// Sample
-	if (i + 1 < _baked_cache.size()) {
-		real_t t = fi - i;
-		return Math::lerp(_baked_cache[i], _baked_cache[i + 1], t);
+	if (loaded_cache) {
+		// Sample-ready right away, without going through the bake scheduler.
+		// Same as bake(), pending bakes are dropped and running ones waited for, or they'd publish a table of the old points over this one.
+		BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+		if (scheduler) {
+			scheduler->cancel(this);
+		}
+		_bake_pending.store(false, std::memory_order_release);
+		{
+			std::lock_guard<std::mutex> bake_lock(_bake_mutex);
+			_update_segments();
+			{
+				std::unique_lock<std::mutex> lock(_update_param_mutex);
+				_bake_dirty_from = MAX_X;
+				_bake_dirty_to = MIN_X;
+			}
+			SegmentsRef segments = get_segments();
+			loaded_cache = _attach_derived_tables(loaded_cache, *segments, _bake_inverse, _bake_integral, _bake_resolution);
+			BetterCurveCacheInterner *interner = _share_baked_cache ? BetterCurveCacheInterner::get_singleton() : nullptr;
+			if (interner) {
+				loaded_cache = interner->intern(BetterCurveCacheInterner::Key(segments, _bake_resolution, _bake_tolerance, _bake_precision, _min_value, _max_value, _bake_inverse, _bake_integral), loaded_cache);
+			}
+			_publish_baked_cache(loaded_cache);
+		}
+		_baked_cache_dirty = false;
+		emit_changed();
 	} else {
-		return _baked_cache[_baked_cache.size() - 1];
+		_queue_update();
 	}
-}
 
-void BetterCurve::ensure_default_setup(real_t p_min, real_t p_max) {
-	if (_points.size() == 0 && _min_value == 0 && _max_value == 1) {
-		add_point(Vector2(0, 1));
-		add_point(Vector2(1, 1));
-		set_min_value(p_min);
-		set_max_value(p_max);
+	if (old_size != static_cast<int>(point_count)) {
+		_notify_point_count_changed();
 	}
 }
 
-bool BetterCurve::_set(const StringName &p_name, const Variant &p_value) {
-	Vector<String> components = String(p_name).split("/", true, 2);
-	if (components.size() >= 2 && components[0].begins_with("point_") && components[0].trim_prefix("point_").is_valid_int()) {
-		int point_index = components[0].trim_prefix("point_").to_int();
-		const String &property = components[1];
-		if (property == "position") {
-			Vector2 position = p_value.operator Vector2();
-			set_point_offset(point_index, position.x);
-			set_point_value(point_index, position.y);
-			return true;
-		} else if (property == "left_tangent") {
-			set_point_left_tangent(point_index, p_value);
-			return true;
-		} else if (property == "left_mode") {
-			int mode = p_value;
-			set_point_left_mode(point_index, (TangentMode)mode);
-			return true;
-		} else if (property == "right_tangent") {
-			set_point_right_tangent(point_index, p_value);
-			return true;
-		} else if (property == "right_mode") {
-			int mode = p_value;
-			set_point_right_mode(point_index, (TangentMode)mode);
-			return true;
-		}
+void BetterCurve::set_bake_inverse(bool p_enabled) {
+	if (_bake_inverse == p_enabled) {
+		return;
+	}
+	_bake_inverse = p_enabled;
+	if (!_points.is_empty()) {
+		_queue_update();
 	}
-	return false;
 }
 
-bool BetterCurve::_get(const StringName &p_name, Variant &r_ret) const {
-	Vector<String> components = String(p_name).split("/", true, 2);
-	if (components.size() >= 2 && components[0].begins_with("point_") && components[0].trim_prefix("point_").is_valid_int()) {
-		int point_index = components[0].trim_prefix("point_").to_int();
-		const String &property = components[1];
-		if (property == "position") {
-			r_ret = get_point_position(point_index);
-			return true;
-		} else if (property == "left_tangent") {
-			r_ret = get_point_left_tangent(point_index);
-			return true;
-		} else if (property == "left_mode") {
-			r_ret = get_point_left_mode(point_index);
-			return true;
-		} else if (property == "right_tangent") {
-			r_ret = get_point_right_tangent(point_index);
-			return true;
-		} else if (property == "right_mode") {
-			r_ret = get_point_right_mode(point_index);
-			return true;
-		}
+bool BetterCurve::is_monotone() const {
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		segments = _build_segments(_points);
 	}
-	return false;
+	return segments->get_monotonicity() != 0;
 }
 
-void BetterCurve::_get_property_list(List<PropertyInfo> *p_list) const {
-	for (int i = 0; i < _points.size(); i++) {
-		PropertyInfo pi = PropertyInfo(Variant::VECTOR2, vformat("point_%d/position", i));
-		pi.usage &= ~PROPERTY_USAGE_STORAGE;
-		p_list->push_back(pi);
-
-		if (i != 0) {
-			pi = PropertyInfo(Variant::FLOAT, vformat("point_%d/left_tangent", i));
-			pi.usage &= ~PROPERTY_USAGE_STORAGE;
-			p_list->push_back(pi);
-
-			pi = PropertyInfo(Variant::INT, vformat("point_%d/left_mode", i), PROPERTY_HINT_ENUM, "Free,Linear");
-			pi.usage &= ~PROPERTY_USAGE_STORAGE;
-			p_list->push_back(pi);
-		}
-
-		if (i != _points.size() - 1) {
-			pi = PropertyInfo(Variant::FLOAT, vformat("point_%d/right_tangent", i));
-			pi.usage &= ~PROPERTY_USAGE_STORAGE;
-			p_list->push_back(pi);
+real_t BetterCurve::sample_inverse(real_t p_value) const {
+	ERR_FAIL_COND_V_MSG(!_bake_inverse, MIN_X, "BetterCurve inverse sampling needs bake_inverse to be enabled.");
+	_prioritize_bake();
+	BakedCacheRef cache = get_baked_cache();
+	if (cache && cache->inverse_baked) {
+		ERR_FAIL_COND_V_MSG(cache->inverse.is_empty(), MIN_X, "BetterCurve isn't monotone, it has no inverse.");
+		return cache->sample_inverse(p_value);
+	}
 
-			pi = PropertyInfo(Variant::INT, vformat("point_%d/right_mode", i), PROPERTY_HINT_ENUM, "Free,Linear");
-			pi.usage &= ~PROPERTY_USAGE_STORAGE;
-			p_list->push_back(pi);
-		}
+	// The first bake with the inverse isn't there yet.
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		segments = _build_segments(_points);
 	}
+	const int monotonicity = segments->get_monotonicity();
+	ERR_FAIL_COND_V_MSG(monotonicity == 0, MIN_X, "BetterCurve isn't monotone, it has no inverse.");
+	return segments->solve(p_value, monotonicity);
 }
 
-void BetterCurve::_bind_methods() {
-	ClassDB::bind_method(D_METHOD("get_point_count"), &BetterCurve::get_point_count);
-	ClassDB::bind_method(D_METHOD("set_point_count", "count"), &BetterCurve::set_point_count);
-	ClassDB::bind_method(D_METHOD("add_point", "position", "left_tangent", "right_tangent", "left_mode", "right_mode"), &BetterCurve::add_point, DEFVAL(0), DEFVAL(0), DEFVAL(TANGENT_FREE), DEFVAL(TANGENT_FREE));
-	ClassDB::bind_method(D_METHOD("remove_point", "index"), &BetterCurve::remove_point);
-	ClassDB::bind_method(D_METHOD("clear_points"), &BetterCurve::clear_points);
-	ClassDB::bind_method(D_METHOD("get_point_position", "index"), &BetterCurve::get_point_position);
-	ClassDB::bind_method(D_METHOD("set_point_value", "index", "y"), &BetterCurve::set_point_value);
-	ClassDB::bind_method(D_METHOD("set_point_offset", "index", "offset"), &BetterCurve::set_point_offset);
-	ClassDB::bind_method(D_METHOD("sample", "offset"), &BetterCurve::sample);
-	ClassDB::bind_method(D_METHOD("sample_baked", "offset"), &BetterCurve::sample_baked);
-	ClassDB::bind_method(D_METHOD("get_point_left_tangent", "index"), &BetterCurve::get_point_left_tangent);
-	ClassDB::bind_method(D_METHOD("get_point_right_tangent", "index"), &BetterCurve::get_point_right_tangent);
-	ClassDB::bind_method(D_METHOD("get_point_left_mode", "index"), &BetterCurve::get_point_left_mode);
-	ClassDB::bind_method(D_METHOD("get_point_right_mode", "index"), &BetterCurve::get_point_right_mode);
-	ClassDB::bind_method(D_METHOD("set_point_left_tangent", "index", "tangent"), &BetterCurve::set_point_left_tangent);
-	ClassDB::bind_method(D_METHOD("set_point_right_tangent", "index", "tangent"), &BetterCurve::set_point_right_tangent);
-	ClassDB::bind_method(D_METHOD("set_point_left_mode", "index", "mode"), &BetterCurve::set_point_left_mode);
-	ClassDB::bind_method(D_METHOD("set_point_right_mode", "index", "mode"), &BetterCurve::set_point_right_mode);
-	ClassDB::bind_method(D_METHOD("get_min_value"), &BetterCurve::get_min_value);
-	ClassDB::bind_method(D_METHOD("set_min_value", "min"), &BetterCurve::set_min_value);
-	ClassDB::bind_method(D_METHOD("get_max_value"), &BetterCurve::get_max_value);
-	ClassDB::bind_method(D_METHOD("set_max_value", "max"), &BetterCurve::set_max_value);
-	ClassDB::bind_method(D_METHOD("clean_dupes"), &BetterCurve::clean_dupes);
-	ClassDB::bind_method(D_METHOD("bake"), &BetterCurve::bake);
-	ClassDB::bind_method(D_METHOD("get_bake_resolution"), &BetterCurve::get_bake_resolution);
-	ClassDB::bind_method(D_METHOD("set_bake_resolution", "resolution"), &BetterCurve::set_bake_resolution);
-	ClassDB::bind_method(D_METHOD("_get_data"), &BetterCurve::get_data);
-	ClassDB::bind_method(D_METHOD("_set_data", "data"), &BetterCurve::set_data);
-
-	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "min_value", PROPERTY_HINT_RANGE, "-1024,1024,0.01"), "set_min_value", "get_min_value");
-	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "max_value", PROPERTY_HINT_RANGE, "-1024,1024,0.01"), "set_max_value", "get_max_value");
-	ADD_PROPERTY(PropertyInfo(Variant::INT, "bake_resolution", PROPERTY_HINT_RANGE, "1,1000,1"), "set_bake_resolution", "get_bake_resolution");
-	ADD_PROPERTY(PropertyInfo(Variant::INT, "_data", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_INTERNAL), "_set_data", "_get_data");
-	ADD_ARRAY_COUNT("Points", "point_count", "set_point_count", "get_point_count", "point_");
-
-	ADD_SIGNAL(MethodInfo(SIGNAL_RANGE_CHANGED));
-	ADD_SIGNAL(MethodInfo(SIGNAL_BAKED));
+Vector2 BetterCurve::get_range_bounds(real_t p_from, real_t p_to) const {
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		segments = _build_segments(_points);
+	}
+	return segments->get_bounds(p_from, p_to);
+}
 
-	BIND_ENUM_CONSTANT(TANGENT_FREE);
-	BIND_ENUM_CONSTANT(TANGENT_LINEAR);
-	BIND_ENUM_CONSTANT(TANGENT_MODE_COUNT);
+real_t BetterCurve::sample_derivative(real_t p_offset) const {
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		return 0;
+	}
+	return segments->derivative(p_offset);
 }
 
-void BetterCurve::_queue_update() {
-	_update_queue_mutex.lock();
-	bool start = true;
-	if (_update_thread.is_started()) {
-		if (!_update_queued) {
-			_update_thread.wait_to_finish();
-		} else {
-			start = false;
+real_t BetterCurve::integrate(real_t p_from, real_t p_to) const {
+	if (_bake_integral) {
+		_prioritize_bake();
+		BakedCacheRef cache = get_baked_cache();
+		if (cache && cache->integral_baked) {
+			return cache->sample_integral(p_to) - cache->sample_integral(p_from);
 		}
 	}
-	if (start) {
-		_update_queued = true;
-		_update_thread.start(BetterCurve::_update_bake, this);
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		segments = _build_segments(_points);
 	}
-	_update_queue_mutex.unlock();
-	emit_changed();
+	return segments->integral(p_to) - segments->integral(p_from);
 }
 
-#define STREAM_UPDATE_WAIT 50
-
-void BetterCurve::_update_bake(void *data) {
-	BetterCurve *curve = reinterpret_cast<BetterCurve *>(data);
-
-	while (curve->_update_queued) {
-		while (curve->_update_queued) {
-			curve->_update_queue_mutex.lock();
-			curve->_update_queued = false;
-			curve->_update_queue_mutex.unlock();
-			std::this_thread::sleep_for(std::chrono::milliseconds(STREAM_UPDATE_WAIT));
-			//std::cout << "No update since " << STREAM_UPDATE_WAIT << "ms. Proceed" << std::endl;
-		}
-		Vector<Point> local_points;
-		curve->_update_param_mutex.lock();
-		local_points = curve->_points.duplicate();
-		curve->_update_param_mutex.unlock();
-		if (curve->_update_queued) {
-			continue;
-		}
-
-		Vector<real_t> cache;
-		int resolution = curve->_bake_resolution;
-		cache.resize(resolution);
-
-		int last_point_id = 0;
-
-		for (int i = 1; i < resolution - 1; ++i) {
-			real_t x = i / static_cast<real_t>(resolution - 1);
-			// Find next point.
-			for (; last_point_id < local_points.size() && local_points[last_point_id].position.x < x;
-					++last_point_id) {
-			}
-			if (last_point_id > 0) {
-				--last_point_id;
-			}
-			real_t y = _sample(x, local_points, last_point_id);
-			cache.write[i] = y;
-		}
-
-		if (local_points.size() != 0) {
-			cache.write[0] = local_points[0].position.y;
-			cache.write[cache.size() - 1] = local_points[local_points.size() - 1].position.y;
-		}
-
-		{
-			std::unique_lock<std::shared_mutex> cache_lock(curve->_getter_mutex);
-			curve->_baked_cache.resize(resolution);
-			for (int i = 0; i < resolution; ++i) {
-				curve->_baked_cache.set(i, cache[i]);
-			}
-		}
+void BetterCurve::set_bake_integral(bool p_enabled) {
+	if (_bake_integral == p_enabled) {
+		return;
+	}
+	_bake_integral = p_enabled;
+	if (!_points.is_empty()) {
+		_queue_update();
 	}
-	curve->emit_signal(SIGNAL_BAKED);
 }
 
-real_t BetterCurve::_sample(real_t offset, const Vector<Point> &points, const int idx) {
-	if (points.size() == 0) {
-		return 0;
+PackedFloat32Array BetterCurve::sample_inverse_array(const PackedFloat32Array &p_values) const {
+	PackedFloat32Array offsets;
+	ERR_FAIL_COND_V_MSG(!_bake_inverse, offsets, "BetterCurve inverse sampling needs bake_inverse to be enabled.");
+	const int count = p_values.size();
+	if (count == 0) {
+		return offsets;
 	}
-	if (points.size() == 1) {
-		return points[0].position.y;
+	offsets.resize(count);
+	float *w = offsets.ptrw();
+	const float *r = p_values.ptr();
+
+	_prioritize_bake();
+	BakedCacheRef cache = get_baked_cache();
+	if (cache && cache->inverse_baked) {
+		ERR_FAIL_COND_V_MSG(cache->inverse.is_empty(), PackedFloat32Array(), "BetterCurve isn't monotone, it has no inverse.");
+		for (int k = 0; k < count; ++k) {
+			w[k] = cache->sample_inverse(r[k]);
+		}
+		return offsets;
 	}
 
-	if (idx == points.size() - 1) {
-		return points[idx].position.y;
+	for (int k = 0; k < count; ++k) {
+		w[k] = sample_inverse(r[k]);
 	}
+	return offsets;
+}
 
-	real_t local = offset - points[idx].position.x;
+void BetterCurve::set_store_baked_cache(bool p_enabled) {
+	_store_baked_cache = p_enabled;
+}
 
-	if (idx == 0 && local <= 0) {
-		return points[0].position.y;
+void BetterCurve::set_share_baked_cache(bool p_enabled) {
+	if (_share_baked_cache == p_enabled) {
+		return;
+	}
+	_share_baked_cache = p_enabled;
+	// Re-baking joins the table of an identical curve, or makes this one available to them.
+	if (p_enabled && !_points.is_empty()) {
+		_queue_update();
 	}
-
-	return _sample_local_nocheck(idx, local, points);
 }
 
-real_t BetterCurve::sample_local_nocheck(int p_index, real_t p_local_offset) const {
-	return _sample_local_nocheck(p_index, p_local_offset, _points);
+void BetterCurve::bake() {
+	// Whatever bake is pending is done right now instead, from the current points.
+	BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+	if (scheduler) {
+		scheduler->cancel(this);
+	}
+	_bake_pending.store(false, std::memory_order_release);
+	_update_segments();
+	{
+		std::lock_guard<std::mutex> lock(_bake_mutex);
+		_bake_now();
+	}
+	_baked_cache_dirty = false;
+	_notify_baked();
+}
+
+void BetterCurve::set_bake_resolution(int p_resolution) {
+	ERR_FAIL_COND(p_resolution < 1);
+	ERR_FAIL_COND(p_resolution > 1000);
+	if (_bake_resolution == p_resolution) {
+		return;
+	}
+	_bake_resolution = p_resolution;
+	_baked_cache_dirty = true;
+	// While loading, the points come after the bake settings, and bring their own bake.
+	if (!_points.is_empty()) {
+		_queue_update();
+	}
+}
+
+void BetterCurve::set_bake_tolerance(real_t p_tolerance) {
+	ERR_FAIL_COND(p_tolerance < 0);
+	if (_bake_tolerance == p_tolerance) {
+		return;
+	}
+	_bake_tolerance = p_tolerance;
+	_baked_cache_dirty = true;
+	if (!_points.is_empty()) {
+		_queue_update();
+	}
+}
+
+BetterCurve::BakedCacheRef BetterCurve::get_baked_cache() const {
+	return std::atomic_load_explicit(&_baked_cache, std::memory_order_acquire);
+}
+
+double BetterCurve::get_average_bake_usec() const {
+	// Both are loaded separately, a bake finishing in between only skews this one read.
+	const uint64_t count = _bake_count.load(std::memory_order_relaxed);
+	return count > 0 ? _bake_usec.load(std::memory_order_relaxed) / static_cast<double>(count) : 0.0;
+}
+
+int64_t BetterCurve::get_baked_cache_memory_usage() const {
+	BakedCacheRef cache = get_baked_cache();
+	return cache ? cache->get_memory_usage() : 0;
+}
+
+BetterCurve::BakedCacheRef BetterCurve::get_sampling_cache() const {
+	_prioritize_bake();
+	return get_baked_cache();
+}
+
+void BetterCurve::_publish_baked_cache(const BakedCacheRef &p_cache) {
+	std::atomic_store_explicit(&_baked_cache, p_cache, std::memory_order_release);
+	_bake_generation.fetch_add(1, std::memory_order_release);
+}
+
+void BetterCurve::_notify_baked() {
+	// Listeners are notified on the main thread, once the snapshot is published.
+	if (Thread::is_main_thread()) {
+		emit_signal(SIGNAL_BAKED);
+		return;
+	}
+	// Bakes finishing before the main thread gets to it only notify once.
+	if (!_baked_notification_queued.exchange(true, std::memory_order_acq_rel)) {
+		callable_mp(this, &BetterCurve::_emit_baked).call_deferred();
+	}
+}
+
+void BetterCurve::_emit_baked() {
+	_baked_notification_queued.store(false, std::memory_order_release);
+	emit_signal(SIGNAL_BAKED);
+}
+
+bool BetterCurve::wait_for_bake(int p_timeout_ms) {
+	if (_bake_pending.load(std::memory_order_acquire)) {
+		_bake_lazy();
+		return true;
+	}
+	BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+	if (!scheduler) {
+		return true;
+	}
+	return scheduler->wait(this, p_timeout_ms);
+}
+
+real_t BetterCurve::sample_baked(real_t p_offset) const {
+	_prioritize_bake();
+	BakedCacheRef cache = get_baked_cache();
+	// Special case if nothing has been baked yet
+	if (!cache || cache->get_count() == 0) {
+		if (_points.size() == 0) {
+			return 0;
+		}
+		return _points.y[0];
+	}
+
+	return cache->sample(p_offset);
+}
+
+void BetterCurve::sample_n(const real_t *p_offsets, real_t *r_values, int p_count) const {
+	ERR_FAIL_COND(p_count < 0);
+	if (p_count == 0) {
+		return;
+	}
+	ERR_FAIL_NULL(p_offsets);
+	ERR_FAIL_NULL(r_values);
+
+	_prioritize_bake();
+	BakedCacheRef cache = get_baked_cache();
+	if (!cache || cache->get_count() == 0) {
+		// Same special case as sample_baked(), the whole batch gets the same value.
+		real_t value = _points.size() != 0 ? _points.y[0] : 0;
+		for (int k = 0; k < p_count; ++k) {
+			r_values[k] = value;
+		}
+		return;
+	}
+
+	cache->sample_n(p_offsets, r_values, p_count);
+}
+
+PackedFloat32Array BetterCurve::sample_array(const PackedFloat32Array &p_offsets) const {
+	PackedFloat32Array values;
+	const int count = p_offsets.size();
+	values.resize(count);
+	if (count == 0) {
+		return values;
+	}
+
+#ifdef REAL_T_IS_DOUBLE
+	Vector<real_t> offsets;
+	offsets.resize(count);
+	real_t *offsets_w = offsets.ptrw();
+	const float *offsets_r = p_offsets.ptr();
+	for (int k = 0; k < count; ++k) {
+		offsets_w[k] = offsets_r[k];
+	}
+
+	Vector<real_t> results;
+	results.resize(count);
+	sample_n(offsets.ptr(), results.ptrw(), count);
+
+	float *values_w = values.ptrw();
+	const real_t *results_r = results.ptr();
+	for (int k = 0; k < count; ++k) {
+		values_w[k] = results_r[k];
+	}
+#else
+	sample_n(p_offsets.ptr(), values.ptrw(), count);
+#endif
+
+	return values;
+}
+
+real_t BetterCurve::BakedCache::get_value(int p_index) const {
+	switch (precision) {
+		case BAKE_PRECISION_HALF:
+			return Math::half_to_float(quantized[p_index]);
+		case BAKE_PRECISION_UNORM16:
+			return quantized[p_index] * scale + bias;
+		default:
+			return values[p_index];
+	}
+}
+
+real_t BetterCurve::BakedCache::sample(real_t p_offset) const {
+	if (is_adaptive()) {
+		return _sample_adaptive(p_offset);
+	}
+
+	const int size = get_count();
+	if (size == 1) {
+		return get_value(0);
+	}
+
+	// Get interpolation index
+	real_t fi = clamp_to_index_range(p_offset, MIN_X, MAX_X) * (size - 1);
+	int i = Math::floor(fi);
+	if (i < 0) {
+		i = 0;
+		fi = 0;
+	} else if (i >= size) {
+		i = size - 1;
+		fi = 0;
+	}
+
+	// Sample
+	if (i + 1 < size) {
+		real_t t = fi - i;
+		switch (precision) {
+			case BAKE_PRECISION_HALF:
+				return Math::lerp((real_t)Math::half_to_float(quantized[i]), (real_t)Math::half_to_float(quantized[i + 1]), t);
+			case BAKE_PRECISION_UNORM16:
+				// Decoding is affine, so it's applied once to the interpolated code.
+				return Math::lerp((real_t)quantized[i], (real_t)quantized[i + 1], t) * scale + bias;
+			default:
+				return Math::lerp(values[i], values[i + 1], t);
+		}
+	} else {
+		return get_value(size - 1);
+	}
+}
+
+void BetterCurve::BakedCache::sample_n(const real_t *p_offsets, real_t *r_values, int p_count) const {
+	if (is_adaptive()) {
+		for (int k = 0; k < p_count; ++k) {
+			r_values[k] = _sample_adaptive(p_offsets[k]);
+		}
+		return;
+	}
+
+	const int size = get_count();
+	if (size == 1) {
+		const real_t value = get_value(0);
+		for (int k = 0; k < p_count; ++k) {
+			r_values[k] = value;
+		}
+		return;
+	}
+
+	// Branch-free bodies: clamping and index math vectorize, the two table reads are gathers.
+	const real_t last = size - 1;
+	const int last_segment = size - 2;
+	switch (precision) {
+		case BAKE_PRECISION_HALF: {
+			const uint16_t *table = quantized.ptr();
+			for (int k = 0; k < p_count; ++k) {
+				const real_t fi = clamp_to_index_range(p_offsets[k], MIN_X, MAX_X) * last;
+				const int i = MIN(static_cast<int>(fi), last_segment);
+				const real_t t = fi - i;
+				const real_t a = Math::half_to_float(table[i]);
+				r_values[k] = a + (Math::half_to_float(table[i + 1]) - a) * t;
+			}
+		} break;
+		case BAKE_PRECISION_UNORM16: {
+			const uint16_t *table = quantized.ptr();
+			for (int k = 0; k < p_count; ++k) {
+				const real_t fi = clamp_to_index_range(p_offsets[k], MIN_X, MAX_X) * last;
+				const int i = MIN(static_cast<int>(fi), last_segment);
+				const real_t t = fi - i;
+				const real_t a = table[i];
+				r_values[k] = (a + (table[i + 1] - a) * t) * scale + bias;
+			}
+		} break;
+		default: {
+			const real_t *table = values.ptr();
+			for (int k = 0; k < p_count; ++k) {
+				const real_t fi = clamp_to_index_range(p_offsets[k], MIN_X, MAX_X) * last;
+				const int i = MIN(static_cast<int>(fi), last_segment);
+				const real_t t = fi - i;
+				r_values[k] = table[i] + (table[i + 1] - table[i]) * t;
+			}
+		} break;
+	}
+}
+
+real_t BetterCurve::BakedCache::sample_inverse(real_t p_value) const {
+	const int size = inverse.size();
+	// Decreasing curves have a negative scale, both directions map to [0, size - 1].
+	const real_t fi = clamp_to_index_range((p_value - inverse_from) * inverse_scale, 0, size - 1);
+	const int i = MIN(static_cast<int>(fi), size - 2);
+	const real_t t = fi - i;
+	return Math::lerp(inverse[i], inverse[i + 1], t);
+}
+
+real_t BetterCurve::BakedCache::sample_integral(real_t p_offset) const {
+	const int size = integral.size() / 2;
+	const real_t *w = integral.ptr();
+	// Beyond the table the curve is flat, so the integral grows linearly. NaN takes the first branch, and stays NaN.
+	if (!(p_offset > MIN_X)) {
+		return w[0] + w[1] * (p_offset - MIN_X);
+	}
+	if (p_offset >= MAX_X) {
+		return w[2 * size - 2] + w[2 * size - 1] * (p_offset - MAX_X);
+	}
+
+	const real_t h = (MAX_X - MIN_X) / static_cast<real_t>(size - 1);
+	const real_t fi = (p_offset - MIN_X) / h;
+	const int i = MIN(static_cast<int>(fi), size - 2);
+	const real_t t = fi - i;
+	const real_t t2 = t * t;
+	const real_t t3 = t2 * t;
+	// Cubic Hermite interpolation, the derivative of the integral at each node being the curve value there.
+	const real_t *n0 = w + 2 * i;
+	const real_t *n1 = n0 + 2;
+	return (2 * t3 - 3 * t2 + 1) * n0[0] + (t3 - 2 * t2 + t) * h * n0[1] + (3 * t2 - 2 * t3) * n1[0] + (t3 - t2) * h * n1[1];
+}
+
+bool BetterCurve::BakedCache::has_precision(BakePrecision p_precision, real_t p_min, real_t p_max) const {
+	if (precision != p_precision) {
+		return false;
+	}
+	if (precision != BAKE_PRECISION_UNORM16) {
+		return true;
+	}
+	BakedCache expected;
+	expected.set_precision(p_precision, p_min, p_max);
+	return scale == expected.scale && bias == expected.bias;
+}
+
+void BetterCurve::BakedCache::set_precision(BakePrecision p_precision, real_t p_min, real_t p_max) {
+	precision = p_precision;
+	scale = 1.0;
+	bias = 0.0;
+	if (p_precision == BAKE_PRECISION_UNORM16 && p_max > p_min) {
+		scale = (p_max - p_min) / UINT16_MAX;
+		bias = p_min;
+	}
+}
+
+void BetterCurve::BakedCache::encode(int p_from, int p_to, const real_t *p_values) {
+	uint16_t *q = quantized.ptrw();
+	if (precision == BAKE_PRECISION_HALF) {
+		for (int i = p_from; i <= p_to; ++i) {
+			q[i] = Math::make_half_float(p_values[i]);
+		}
+	} else {
+		const real_t inv_scale = 1.0 / scale;
+		for (int i = p_from; i <= p_to; ++i) {
+			q[i] = static_cast<uint16_t>(CLAMP(Math::round((p_values[i] - bias) * inv_scale), (real_t)0, (real_t)UINT16_MAX));
+		}
+	}
+}
+
+uint64_t BetterCurve::BakedCache::get_memory_usage() const {
+	return sizeof(BakedCache) +
+			values.size() * sizeof(real_t) +
+			offsets.size() * sizeof(real_t) +
+			index.size() * sizeof(int32_t) +
+			quantized.size() * sizeof(uint16_t) +
+			inverse.size() * sizeof(real_t) +
+			integral.size() * sizeof(real_t);
+}
+
+void BetterCurve::ensure_default_setup(real_t p_min, real_t p_max) {
+	if (_points.size() == 0 && _min_value == 0 && _max_value == 1) {
+		add_point(Vector2(0, 1));
+		add_point(Vector2(1, 1));
+		set_min_value(p_min);
+		set_max_value(p_max);
+	}
+}
+
+LocalVector<BetterCurve::PointPropertyNames *> BetterCurve::_point_property_names;
+std::mutex BetterCurve::_point_property_names_mutex;
+
+BetterCurve::PointPropertyNames::PointPropertyNames(int p_index) :
+		position(vformat("point_%d/position", p_index)),
+		left_tangent(vformat("point_%d/left_tangent", p_index)),
+		left_mode(vformat("point_%d/left_mode", p_index)),
+		right_tangent(vformat("point_%d/right_tangent", p_index)),
+		right_mode(vformat("point_%d/right_mode", p_index)) {
+}
+
+bool BetterCurve::_parse_point_index(const StringName &p_name, int &r_index) {
+	// A copy of the StringName's String only shares its buffer.
+	const String name = p_name;
+	const char32_t *c = name.get_data();
+	static const char32_t PREFIX[] = U"point_";
+	for (int i = 0; PREFIX[i]; ++i, ++c) {
+		if (*c != PREFIX[i]) {
+			return false;
+		}
+	}
+	if (*c < '0' || *c > '9') {
+		return false;
+	}
+	int index = 0;
+	for (; *c >= '0' && *c <= '9'; ++c) {
+		if (index > (INT32_MAX - 9) / 10) {
+			return false;
+		}
+		index = index * 10 + (*c - '0');
+	}
+	if (*c != '/') {
+		return false;
+	}
+	r_index = index;
+	return true;
+}
+
+const BetterCurve::PointPropertyNames &BetterCurve::_get_point_property_names(int p_index) {
+	std::lock_guard<std::mutex> lock(_point_property_names_mutex);
+	while ((int)_point_property_names.size() <= p_index) {
+		_point_property_names.push_back(memnew(PointPropertyNames(_point_property_names.size())));
+	}
+	// Entries are never moved, only the pointers to them are.
+	return *_point_property_names[p_index];
+}
+
+void BetterCurve::free_point_property_names() {
+	std::lock_guard<std::mutex> lock(_point_property_names_mutex);
+	for (PointPropertyNames *names : _point_property_names) {
+		memdelete(names);
+	}
+	_point_property_names.reset();
+}
+
+bool BetterCurve::_set(const StringName &p_name, const Variant &p_value) {
+	int point_index = 0;
+	if (!_parse_point_index(p_name, point_index)) {
+		return false;
+	}
+	ERR_FAIL_INDEX_V(point_index, _points.size(), false);
+	const PointPropertyNames &names = _get_point_property_names(point_index);
+	if (p_name == names.position) {
+		Vector2 position = p_value.operator Vector2();
+		begin_edit();
+		// Moving past a neighbour changes the point's index.
+		int new_index = set_point_offset(point_index, position.x);
+		if (new_index >= 0) {
+			set_point_value(new_index, position.y);
+		}
+		commit_edit();
+		return true;
+	} else if (p_name == names.left_tangent) {
+		set_point_left_tangent(point_index, p_value);
+		return true;
+	} else if (p_name == names.left_mode) {
+		int mode = p_value;
+		set_point_left_mode(point_index, (TangentMode)mode);
+		return true;
+	} else if (p_name == names.right_tangent) {
+		set_point_right_tangent(point_index, p_value);
+		return true;
+	} else if (p_name == names.right_mode) {
+		int mode = p_value;
+		set_point_right_mode(point_index, (TangentMode)mode);
+		return true;
+	}
+	return false;
+}
+
+bool BetterCurve::_get(const StringName &p_name, Variant &r_ret) const {
+	int point_index = 0;
+	if (!_parse_point_index(p_name, point_index)) {
+		return false;
+	}
+	ERR_FAIL_INDEX_V(point_index, _points.size(), false);
+	const PointPropertyNames &names = _get_point_property_names(point_index);
+	if (p_name == names.position) {
+		r_ret = get_point_position(point_index);
+		return true;
+	} else if (p_name == names.left_tangent) {
+		r_ret = get_point_left_tangent(point_index);
+		return true;
+	} else if (p_name == names.left_mode) {
+		r_ret = get_point_left_mode(point_index);
+		return true;
+	} else if (p_name == names.right_tangent) {
+		r_ret = get_point_right_tangent(point_index);
+		return true;
+	} else if (p_name == names.right_mode) {
+		r_ret = get_point_right_mode(point_index);
+		return true;
+	}
+	return false;
+}
+
+void BetterCurve::_get_property_list(List<PropertyInfo> *p_list) const {
+	if (_property_list_point_count != _points.size()) {
+		_property_list.clear();
+		for (int i = 0; i < _points.size(); i++) {
+			const PointPropertyNames &names = _get_point_property_names(i);
+			PropertyInfo pi = PropertyInfo(Variant::VECTOR2, names.position);
+			pi.usage &= ~PROPERTY_USAGE_STORAGE;
+			_property_list.push_back(pi);
+
+			if (i != 0) {
+				pi = PropertyInfo(Variant::FLOAT, names.left_tangent);
+				pi.usage &= ~PROPERTY_USAGE_STORAGE;
+				_property_list.push_back(pi);
+
+				pi = PropertyInfo(Variant::INT, names.left_mode, PROPERTY_HINT_ENUM, "Free,Linear");
+				pi.usage &= ~PROPERTY_USAGE_STORAGE;
+				_property_list.push_back(pi);
+			}
+
+			if (i != _points.size() - 1) {
+				pi = PropertyInfo(Variant::FLOAT, names.right_tangent);
+				pi.usage &= ~PROPERTY_USAGE_STORAGE;
+				_property_list.push_back(pi);
+
+				pi = PropertyInfo(Variant::INT, names.right_mode, PROPERTY_HINT_ENUM, "Free,Linear");
+				pi.usage &= ~PROPERTY_USAGE_STORAGE;
+				_property_list.push_back(pi);
+			}
+		}
+		_property_list_point_count = _points.size();
+	}
+
+	for (const PropertyInfo &pi : _property_list) {
+		p_list->push_back(pi);
+	}
+}
+
+void BetterCurve::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("get_point_count"), &BetterCurve::get_point_count);
+	ClassDB::bind_method(D_METHOD("set_point_count", "count"), &BetterCurve::set_point_count);
+	ClassDB::bind_method(D_METHOD("add_point", "position", "left_tangent", "right_tangent", "left_mode", "right_mode"), &BetterCurve::add_point, DEFVAL(0), DEFVAL(0), DEFVAL(TANGENT_FREE), DEFVAL(TANGENT_FREE));
+	ClassDB::bind_method(D_METHOD("remove_point", "index"), &BetterCurve::remove_point);
+	ClassDB::bind_method(D_METHOD("clear_points"), &BetterCurve::clear_points);
+	ClassDB::bind_method(D_METHOD("set_points", "positions", "left_tangents", "right_tangents", "left_modes", "right_modes"), &BetterCurve::set_points, DEFVAL(PackedFloat32Array()), DEFVAL(PackedFloat32Array()), DEFVAL(PackedInt32Array()), DEFVAL(PackedInt32Array()));
+	ClassDB::bind_method(D_METHOD("begin_edit"), &BetterCurve::begin_edit);
+	ClassDB::bind_method(D_METHOD("commit_edit"), &BetterCurve::commit_edit);
+	ClassDB::bind_method(D_METHOD("get_point_position", "index"), &BetterCurve::get_point_position);
+	ClassDB::bind_method(D_METHOD("set_point_value", "index", "y"), &BetterCurve::set_point_value);
+	ClassDB::bind_method(D_METHOD("set_point_offset", "index", "offset"), &BetterCurve::set_point_offset);
+	ClassDB::bind_method(D_METHOD("sample", "offset"), &BetterCurve::sample);
+	ClassDB::bind_method(D_METHOD("sample_baked", "offset"), &BetterCurve::sample_baked);
+	ClassDB::bind_method(D_METHOD("sample_exact", "offset"), &BetterCurve::sample_exact);
+	ClassDB::bind_method(D_METHOD("sample_array", "offsets"), &BetterCurve::sample_array);
+	ClassDB::bind_method(D_METHOD("to_shader_function", "name"), &BetterCurve::to_shader_function);
+	ClassDB::bind_method(D_METHOD("is_baking_inverse"), &BetterCurve::is_baking_inverse);
+	ClassDB::bind_method(D_METHOD("set_bake_inverse", "enabled"), &BetterCurve::set_bake_inverse);
+	ClassDB::bind_method(D_METHOD("is_monotone"), &BetterCurve::is_monotone);
+	ClassDB::bind_method(D_METHOD("sample_inverse", "value"), &BetterCurve::sample_inverse);
+	ClassDB::bind_method(D_METHOD("sample_inverse_array", "values"), &BetterCurve::sample_inverse_array);
+	ClassDB::bind_method(D_METHOD("get_range_bounds", "from", "to"), &BetterCurve::get_range_bounds);
+	ClassDB::bind_method(D_METHOD("sample_derivative", "offset"), &BetterCurve::sample_derivative);
+	ClassDB::bind_method(D_METHOD("integrate", "from", "to"), &BetterCurve::integrate);
+	ClassDB::bind_method(D_METHOD("is_baking_integral"), &BetterCurve::is_baking_integral);
+	ClassDB::bind_method(D_METHOD("set_bake_integral", "enabled"), &BetterCurve::set_bake_integral);
+	ClassDB::bind_method(D_METHOD("get_point_left_tangent", "index"), &BetterCurve::get_point_left_tangent);
+	ClassDB::bind_method(D_METHOD("get_point_right_tangent", "index"), &BetterCurve::get_point_right_tangent);
+	ClassDB::bind_method(D_METHOD("get_point_left_mode", "index"), &BetterCurve::get_point_left_mode);
+	ClassDB::bind_method(D_METHOD("get_point_right_mode", "index"), &BetterCurve::get_point_right_mode);
+	ClassDB::bind_method(D_METHOD("set_point_left_tangent", "index", "tangent"), &BetterCurve::set_point_left_tangent);
+	ClassDB::bind_method(D_METHOD("set_point_right_tangent", "index", "tangent"), &BetterCurve::set_point_right_tangent);
+	ClassDB::bind_method(D_METHOD("set_point_left_mode", "index", "mode"), &BetterCurve::set_point_left_mode);
+	ClassDB::bind_method(D_METHOD("set_point_right_mode", "index", "mode"), &BetterCurve::set_point_right_mode);
+	ClassDB::bind_method(D_METHOD("get_min_value"), &BetterCurve::get_min_value);
+	ClassDB::bind_method(D_METHOD("set_min_value", "min"), &BetterCurve::set_min_value);
+	ClassDB::bind_method(D_METHOD("get_max_value"), &BetterCurve::get_max_value);
+	ClassDB::bind_method(D_METHOD("set_max_value", "max"), &BetterCurve::set_max_value);
+	ClassDB::bind_method(D_METHOD("clean_dupes"), &BetterCurve::clean_dupes);
+	ClassDB::bind_method(D_METHOD("bake"), &BetterCurve::bake);
+	ClassDB::bind_method(D_METHOD("get_bake_resolution"), &BetterCurve::get_bake_resolution);
+	ClassDB::bind_method(D_METHOD("set_bake_resolution", "resolution"), &BetterCurve::set_bake_resolution);
+	ClassDB::bind_method(D_METHOD("get_bake_generation"), &BetterCurve::get_bake_generation);
+	ClassDB::bind_method(D_METHOD("get_bake_count"), &BetterCurve::get_bake_count);
+	ClassDB::bind_method(D_METHOD("get_last_bake_usec"), &BetterCurve::get_last_bake_usec);
+	ClassDB::bind_method(D_METHOD("get_average_bake_usec"), &BetterCurve::get_average_bake_usec);
+	ClassDB::bind_method(D_METHOD("get_coalesced_update_count"), &BetterCurve::get_coalesced_update_count);
+	ClassDB::bind_method(D_METHOD("get_baked_cache_memory_usage"), &BetterCurve::get_baked_cache_memory_usage);
+	ClassDB::bind_method(D_METHOD("wait_for_bake", "timeout_ms"), &BetterCurve::wait_for_bake, DEFVAL(-1));
+	ClassDB::bind_method(D_METHOD("get_bake_mode"), &BetterCurve::get_bake_mode);
+	ClassDB::bind_method(D_METHOD("set_bake_mode", "mode"), &BetterCurve::set_bake_mode);
+	ClassDB::bind_method(D_METHOD("get_bake_precision"), &BetterCurve::get_bake_precision);
+	ClassDB::bind_method(D_METHOD("set_bake_precision", "precision"), &BetterCurve::set_bake_precision);
+	ClassDB::bind_method(D_METHOD("get_bake_tolerance"), &BetterCurve::get_bake_tolerance);
+	ClassDB::bind_method(D_METHOD("set_bake_tolerance", "tolerance"), &BetterCurve::set_bake_tolerance);
+	ClassDB::bind_method(D_METHOD("get_bake_debounce_ms"), &BetterCurve::get_bake_debounce_ms);
+	ClassDB::bind_method(D_METHOD("set_bake_debounce_ms", "debounce_ms"), &BetterCurve::set_bake_debounce_ms);
+	ClassDB::bind_method(D_METHOD("_get_data"), &BetterCurve::get_data);
+	ClassDB::bind_method(D_METHOD("_set_data", "data"), &BetterCurve::set_data);
+	ClassDB::bind_method(D_METHOD("_get_packed_data"), &BetterCurve::get_packed_data);
+	ClassDB::bind_method(D_METHOD("_set_packed_data", "data"), &BetterCurve::set_packed_data);
+	ClassDB::bind_method(D_METHOD("is_storing_baked_cache"), &BetterCurve::is_storing_baked_cache);
+	ClassDB::bind_method(D_METHOD("set_store_baked_cache", "enabled"), &BetterCurve::set_store_baked_cache);
+	ClassDB::bind_method(D_METHOD("is_sharing_baked_cache"), &BetterCurve::is_sharing_baked_cache);
+	ClassDB::bind_method(D_METHOD("set_share_baked_cache", "enabled"), &BetterCurve::set_share_baked_cache);
+
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "min_value", PROPERTY_HINT_RANGE, "-1024,1024,0.01"), "set_min_value", "get_min_value");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "max_value", PROPERTY_HINT_RANGE, "-1024,1024,0.01"), "set_max_value", "get_max_value");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "bake_resolution", PROPERTY_HINT_RANGE, "1,1000,1"), "set_bake_resolution", "get_bake_resolution");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "bake_mode", PROPERTY_HINT_ENUM, "Async,Sync,Lazy On First Sample"), "set_bake_mode", "get_bake_mode");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "bake_precision", PROPERTY_HINT_ENUM, "Full,Half,Normalized 16-bit"), "set_bake_precision", "get_bake_precision");
+	ADD_PROPERTY(PropertyInfo(Variant::FLOAT, "bake_tolerance", PROPERTY_HINT_RANGE, "0,1,0.0001,or_greater"), "set_bake_tolerance", "get_bake_tolerance");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "bake_inverse"), "set_bake_inverse", "is_baking_inverse");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "bake_integral"), "set_bake_integral", "is_baking_integral");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "bake_debounce_ms", PROPERTY_HINT_RANGE, "0,1000,1,suffix:ms"), "set_bake_debounce_ms", "get_bake_debounce_ms");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "store_baked_cache"), "set_store_baked_cache", "is_storing_baked_cache");
+	ADD_PROPERTY(PropertyInfo(Variant::BOOL, "share_baked_cache"), "set_share_baked_cache", "is_sharing_baked_cache");
+	// Not stored anymore, but still read from resources saved before _packed_data.
+	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "_data", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_INTERNAL), "_set_data", "_get_data");
+	ADD_PROPERTY(PropertyInfo(Variant::PACKED_BYTE_ARRAY, "_packed_data", PROPERTY_HINT_NONE, "", PROPERTY_USAGE_NO_EDITOR | PROPERTY_USAGE_INTERNAL), "_set_packed_data", "_get_packed_data");
+	ADD_ARRAY_COUNT("Points", "point_count", "set_point_count", "get_point_count", "point_");
+
+	ADD_SIGNAL(MethodInfo(SIGNAL_RANGE_CHANGED));
+	ADD_SIGNAL(MethodInfo(SIGNAL_BAKED));
+
+	BIND_ENUM_CONSTANT(TANGENT_FREE);
+	BIND_ENUM_CONSTANT(TANGENT_LINEAR);
+	BIND_ENUM_CONSTANT(TANGENT_MODE_COUNT);
+
+	BIND_ENUM_CONSTANT(BAKE_MODE_ASYNC);
+	BIND_ENUM_CONSTANT(BAKE_MODE_SYNC);
+	BIND_ENUM_CONSTANT(BAKE_MODE_LAZY);
+	BIND_ENUM_CONSTANT(BAKE_MODE_COUNT);
+
+	BIND_ENUM_CONSTANT(BAKE_PRECISION_FULL);
+	BIND_ENUM_CONSTANT(BAKE_PRECISION_HALF);
+	BIND_ENUM_CONSTANT(BAKE_PRECISION_UNORM16);
+	BIND_ENUM_CONSTANT(BAKE_PRECISION_COUNT);
+}
+
+void BetterCurve::_queue_update() {
+	{
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		if (_edit_depth > 0) {
+			_edit_update_pending = true;
+			return;
+		}
+	}
+
+	_update_segments();
+	_schedule_bake();
+	emit_changed();
+}
+
+void BetterCurve::_schedule_bake() {
+	BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+	if (_bake_mode == BAKE_MODE_LAZY) {
+		// The next sample bakes, so curves that are never sampled never bake.
+		if (_bake_pending.exchange(true, std::memory_order_acq_rel)) {
+			_coalesced_update_count.fetch_add(1, std::memory_order_relaxed);
+		}
+	} else if (_bake_mode == BAKE_MODE_ASYNC && scheduler) {
+		scheduler->queue(this, _bake_debounce_ms);
+	} else {
+		// Outside of the module's lifetime there's nothing to defer the bake to either.
+		{
+			std::lock_guard<std::mutex> lock(_bake_mutex);
+			_bake_now();
+		}
+		_notify_baked();
+	}
+}
+
+void BetterCurve::_bake_lazy() {
+	{
+		std::lock_guard<std::mutex> lock(_bake_mutex);
+		// Another reader may have baked while this one was waiting.
+		// Cleared before baking, so an edit made meanwhile is baked by the next sample.
+		if (!_bake_pending.exchange(false, std::memory_order_acq_rel)) {
+			return;
+		}
+		_bake_now();
+	}
+	_notify_baked();
+}
+
+void BetterCurve::set_bake_mode(BakeMode p_mode) {
+	ERR_FAIL_INDEX(p_mode, BAKE_MODE_COUNT);
+	if (_bake_mode == p_mode) {
+		return;
+	}
+	// A pending bake is handed over to the new mode.
+	bool pending = _bake_queued.load(std::memory_order_relaxed) || _bake_pending.exchange(false, std::memory_order_acq_rel);
+	BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+	if (scheduler) {
+		scheduler->cancel(this);
+	}
+	_bake_mode = p_mode;
+	if (pending) {
+		_schedule_bake();
+	}
+}
+
+void BetterCurve::_prioritize_bake() const {
+	if (_bake_pending.load(std::memory_order_acquire)) {
+		const_cast<BetterCurve *>(this)->_bake_lazy();
+		return;
+	}
+	// Only the first sample of a pending bake goes through the scheduler.
+	if (_bake_queued.load(std::memory_order_relaxed) && !_bake_prioritized.exchange(true)) {
+		BetterCurveBakeScheduler *scheduler = BetterCurveBakeScheduler::get_singleton();
+		if (scheduler) {
+			scheduler->prioritize(const_cast<BetterCurve *>(this));
+		}
+	}
+}
+
+void BetterCurve::set_bake_precision(BakePrecision p_precision) {
+	ERR_FAIL_INDEX(p_precision, BAKE_PRECISION_COUNT);
+	if (_bake_precision == p_precision) {
+		return;
+	}
+	_bake_precision = p_precision;
+	_baked_cache_dirty = true;
+	// Same as the resolution, loaded points bring a bake with the new precision already.
+	if (!_points.is_empty()) {
+		_queue_update();
+	}
+}
+
+void BetterCurve::set_bake_debounce_ms(int p_debounce_ms) {
+	ERR_FAIL_COND(p_debounce_ms < 0);
+	_bake_debounce_ms = p_debounce_ms;
+}
+
+void BetterCurve::_bake_now() {
+	const uint64_t start = OS::get_singleton()->get_ticks_usec();
+	_rebake_cache();
+	const uint64_t usec = OS::get_singleton()->get_ticks_usec() - start;
+
+	_bake_count.fetch_add(1, std::memory_order_relaxed);
+	_bake_usec.fetch_add(usec, std::memory_order_relaxed);
+	_last_bake_usec.store(usec, std::memory_order_relaxed);
+	BetterCurveStats::record_bake(usec);
+}
+
+void BetterCurve::_rebake_cache() {
+	// The segments and the interval they changed in since the last bake are taken together.
+	SegmentsRef segments;
+	real_t dirty_from;
+	real_t dirty_to;
+	{
+		std::unique_lock<std::mutex> lock(_update_param_mutex);
+		segments = get_segments();
+		dirty_from = _bake_dirty_from;
+		dirty_to = _bake_dirty_to;
+		_bake_dirty_from = MAX_X;
+		_bake_dirty_to = MIN_X;
+	}
+	if (!segments) {
+		segments = _build_segments(Points());
+	}
+
+	const int resolution = _bake_resolution;
+	const real_t tolerance = _bake_tolerance;
+	const BakePrecision precision = _bake_precision;
+	const real_t min_value = _min_value;
+	const real_t max_value = _max_value;
+	const bool bake_inverse = _bake_inverse;
+	const bool bake_integral = _bake_integral;
+
+	// A curve with the same content may have baked this table already.
+	BetterCurveCacheInterner *interner = _share_baked_cache ? BetterCurveCacheInterner::get_singleton() : nullptr;
+	BetterCurveCacheInterner::Key key;
+	if (interner) {
+		key = BetterCurveCacheInterner::Key(segments, resolution, tolerance, precision, min_value, max_value, bake_inverse, bake_integral);
+		BakedCacheRef shared = interner->find(key);
+		if (shared) {
+			if (shared != get_baked_cache()) {
+				_publish_baked_cache(shared);
+			}
+			return;
+		}
+	}
+
+	// Readers keep whatever snapshot they already hold, the new one is swapped in as a whole.
+	BakedCacheRef previous = get_baked_cache();
+	BakedCacheRef baked;
+	if (tolerance > 0) {
+		// Sample positions move with the shape, so adaptive bakes are always done from scratch.
+		baked = _bake_segments_adaptive(*segments, tolerance);
+	} else if (!previous || previous->is_adaptive() || previous->get_count() != resolution || !previous->has_precision(precision, min_value, max_value)) {
+		baked = _quantize_baked_cache(_bake_segments(*segments, resolution), precision, min_value, max_value);
+	} else if (dirty_from > dirty_to) {
+		// Nothing moved since the previous bake, but the derived tables may have been toggled.
+		if (previous->inverse_baked == bake_inverse && previous->integral_baked == bake_integral) {
+			if (interner) {
+				_publish_baked_cache(interner->intern(key, previous));
+			}
+			return;
+		}
+		baked = previous;
+	} else {
+		// Only patch the values covering the dirty interval into a copy of the previous table.
+		std::shared_ptr<BakedCache> cache = std::make_shared<BakedCache>(*previous);
+		const real_t scale = resolution - 1;
+		int from = CLAMP(static_cast<int>(Math::floor((dirty_from - MIN_X) * scale)), 0, resolution - 1);
+		int to = CLAMP(static_cast<int>(Math::ceil((dirty_to - MIN_X) * scale)), 0, resolution - 1);
+		if (precision == BAKE_PRECISION_FULL) {
+			_bake_segments_range(*segments, resolution, from, to, cache->values.ptrw());
+		} else {
+			LocalVector<real_t> patch;
+			patch.resize(resolution);
+			_bake_segments_range(*segments, resolution, from, to, patch.ptr());
+			cache->encode(from, to, patch.ptr());
+		}
+		baked = cache;
+	}
+	baked = _attach_derived_tables(baked, *segments, bake_inverse, bake_integral, resolution);
+
+	// Another curve may have interned the same content meanwhile, its table is used instead.
+	_publish_baked_cache(interner ? interner->intern(key, baked) : baked);
+}
+
+BetterCurve::BakedCacheRef BetterCurve::_bake_segments(const Segments &p_segments, int p_resolution) {
+	std::shared_ptr<BakedCache> cache = std::make_shared<BakedCache>();
+	cache->values.resize(p_resolution);
+	_bake_segments_range(p_segments, p_resolution, 0, p_resolution - 1, cache->values.ptrw());
+	return cache;
+}
+
+BetterCurve::BakedCacheRef BetterCurve::_attach_derived_tables(const BakedCacheRef &p_cache, const Segments &p_segments, bool p_inverse, bool p_integral, int p_resolution) {
+	if (!p_inverse && !p_cache->inverse_baked && !p_integral && !p_cache->integral_baked) {
+		return p_cache;
+	}
+	// Only the derived tables change, the other ones are shared with p_cache.
+	std::shared_ptr<BakedCache> cache = std::make_shared<BakedCache>(*p_cache);
+	cache->inverse_baked = p_inverse;
+	cache->inverse.clear();
+	cache->inverse_from = 0;
+	cache->inverse_scale = 0;
+	cache->integral_baked = p_integral;
+	cache->integral.clear();
+
+	const int size = MAX(p_resolution, 2);
+	const int monotonicity = p_inverse ? p_segments.get_monotonicity() : 0;
+	if (monotonicity != 0) {
+		const real_t from = p_segments.first_y;
+		const real_t to = p_segments.last_y;
+		cache->inverse.resize(size);
+		real_t *w = cache->inverse.ptrw();
+		for (int i = 0; i < size; ++i) {
+			w[i] = p_segments.solve(Math::lerp(from, to, i / static_cast<real_t>(size - 1)), monotonicity);
+		}
+		cache->inverse_from = from;
+		cache->inverse_scale = (size - 1) / (to - from);
+	}
+
+	if (p_integral) {
+		cache->integral.resize(size * 2);
+		real_t *w = cache->integral.ptrw();
+		for (int i = 0; i < size; ++i) {
+			const real_t x = MIN_X + (MAX_X - MIN_X) * i / static_cast<real_t>(size - 1);
+			w[2 * i] = p_segments.integral(x);
+			w[2 * i + 1] = p_segments.sample(x);
+		}
+	}
+	return cache;
+}
+
+BetterCurve::BakedCacheRef BetterCurve::_quantize_baked_cache(const BakedCacheRef &p_cache, BakePrecision p_precision, real_t p_min, real_t p_max) {
+	if (p_precision == BAKE_PRECISION_FULL || p_cache->is_adaptive()) {
+		return p_cache;
+	}
+	std::shared_ptr<BakedCache> cache = std::make_shared<BakedCache>();
+	cache->set_precision(p_precision, p_min, p_max);
+	const int count = p_cache->values.size();
+	cache->quantized.resize(count);
+	if (count > 0) {
+		cache->encode(0, count - 1, p_cache->values.ptr());
+	}
+	return cache;
+}
+
+// Bakes samples from p_index on while they're within segment p_segment, and returns the first one that isn't.
+template <BetterCurve::Segments::Kind K>
+static int bake_segment_run(const BetterCurve::Segments &p_segments, int p_segment, int p_index, int p_last, real_t p_denominator, real_t *r_values) {
+	const real_t *x0 = p_segments.x0.ptr();
+	const real_t start = x0[p_segment];
+	const real_t end = x0[p_segment + 1];
+	for (; p_index <= p_last; ++p_index) {
+		const real_t x = p_index / p_denominator;
+		if (x >= end) {
+			break;
+		}
+		r_values[p_index] = p_segments.evaluate<K>(p_segment, x - start);
+	}
+	return p_index;
+}
+
+void BetterCurve::_bake_segments_range(const Segments &p_segments, int p_resolution, int p_from, int p_to, real_t *r_values) {
+	const int segment_count = p_segments.get_count();
+	const real_t *x0 = p_segments.x0.ptr();
+	const real_t denominator = p_resolution - 1;
+	const int last = MIN(p_to, p_resolution - 2);
+	int i = MAX(p_from, 1);
+
+	for (; i <= last && (segment_count == 0 || i / denominator <= x0[0]); ++i) {
+		r_values[i] = p_segments.first_y;
+	}
+	if (i <= last) {
+		// Samples are baked a segment at a time, with the kernel of that segment's kind.
+		// The offsets are increasing, so the segment can only move forward.
+		int segment = p_segments.find(i / denominator);
+		while (i <= last && segment < segment_count) {
+			const real_t x = i / denominator;
+			while (segment < segment_count && x0[segment + 1] <= x) {
+				++segment;
+			}
+			if (segment == segment_count) {
+				break;
+			}
+			switch (p_segments.kind[segment]) {
+				case Segments::KIND_CONSTANT:
+					i = bake_segment_run<Segments::KIND_CONSTANT>(p_segments, segment, i, last, denominator, r_values);
+					break;
+				case Segments::KIND_LINEAR:
+					i = bake_segment_run<Segments::KIND_LINEAR>(p_segments, segment, i, last, denominator, r_values);
+					break;
+				default:
+					i = bake_segment_run<Segments::KIND_CUBIC>(p_segments, segment, i, last, denominator, r_values);
+					break;
+			}
+			++segment;
+		}
+		for (; i <= last; ++i) {
+			r_values[i] = p_segments.last_y;
+		}
+	}
+
+	if (p_from == 0) {
+		r_values[0] = p_segments.first_y;
+	}
+	if (p_to == p_resolution - 1) {
+		r_values[p_resolution - 1] = p_segments.last_y;
+	}
+}
+
+real_t BetterCurve::BakedCache::_sample_adaptive(real_t p_offset) const {
+	const real_t *xs = offsets.ptr();
+	const real_t *ys = values.ptr();
+	const int last = offsets.size() - 1;
+	// Written so that NaN takes this branch as well.
+	if (!(p_offset > xs[0])) {
+		return ys[0];
+	}
+	if (p_offset >= xs[last]) {
+		return ys[last];
+	}
+
+	// The bucket gives a value at or before the offset, the next few are scanned from there.
+	const int bucket_count = index.size();
+	const int bucket = MIN(static_cast<int>((p_offset - MIN_X) * bucket_count), bucket_count - 1);
+	int i = index.ptr()[bucket];
+	while (xs[i + 1] <= p_offset) {
+		++i;
+	}
+
+	// Values sharing an offset are jumps, stopping at the last of them keeps the width non-zero.
+	const real_t t = (p_offset - xs[i]) / (xs[i + 1] - xs[i]);
+	return Math::lerp(ys[i], ys[i + 1], t);
+}
+
+// Adaptive bake limits, to keep degenerate tolerances from blowing up memory and bake time.
+#define ADAPTIVE_BAKE_MAX_DEPTH 16
+#define ADAPTIVE_BAKE_MAX_SAMPLES 65536
+#define ADAPTIVE_BAKE_MAX_MERGE 64
+
+struct AdaptiveBakeContext {
+	const BetterCurve::Segments &segments;
+	real_t tolerance;
+	LocalVector<real_t> xs;
+	LocalVector<real_t> ys;
+
+	AdaptiveBakeContext(const BetterCurve::Segments &p_segments, real_t p_tolerance) :
+			segments(p_segments), tolerance(p_tolerance) {}
+
+	real_t evaluate(int p_segment, real_t p_x) const {
+		return segments.evaluate(p_segment, p_x - segments.x0[p_segment]);
+	}
+
+	// Recursively splits the chord from (xa, ya) to (xb, yb) until it's close enough to the segment.
+	// Only pushes the end of the chord, the start has been pushed already.
+	void subdivide(int p_segment, real_t p_xa, real_t p_ya, real_t p_xb, real_t p_yb, int p_depth) {
+		// A cubic can cross its chord, so probe a few inner points rather than just the middle.
+		real_t error = 0;
+		for (int k = 1; k < 4; ++k) {
+			real_t t = k / 4.0;
+			real_t x = Math::lerp(p_xa, p_xb, t);
+			error = MAX(error, Math::abs(evaluate(p_segment, x) - Math::lerp(p_ya, p_yb, t)));
+		}
+
+		if (error > tolerance && p_depth < ADAPTIVE_BAKE_MAX_DEPTH && static_cast<int>(xs.size()) < ADAPTIVE_BAKE_MAX_SAMPLES) {
+			real_t xm = (p_xa + p_xb) / 2.0;
+			real_t ym = evaluate(p_segment, xm);
+			subdivide(p_segment, p_xa, p_ya, xm, ym, p_depth + 1);
+			subdivide(p_segment, xm, ym, p_xb, p_yb, p_depth + 1);
+		} else {
+			xs.push_back(p_xb);
+			ys.push_back(p_yb);
+		}
+	}
+
+	// Within tolerance of all the samples from p_from to p_to? Between samples both are linear,
+	// so checking the samples bounds the error everywhere.
+	bool chord_fits(int p_from, int p_to) const {
+		real_t width = xs[p_to] - xs[p_from];
+		if (width <= 0) {
+			return false;
+		}
+		for (int k = p_from + 1; k < p_to; ++k) {
+			real_t t = (xs[k] - xs[p_from]) / width;
+			if (Math::abs(ys[k] - Math::lerp(ys[p_from], ys[p_to], t)) > tolerance) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+BetterCurve::BakedCacheRef BetterCurve::_bake_segments_adaptive(const Segments &p_segments, real_t p_tolerance) {
+	// Half of the tolerance goes to the subdivision, the other half to merging flat runs back.
+	AdaptiveBakeContext context(p_segments, p_tolerance / 2.0);
+	const int segment_count = p_segments.get_count();
+
+	context.xs.push_back(MIN_X);
+	context.ys.push_back(p_segments.first_y);
+	for (int i = 0; i < segment_count; ++i) {
+		real_t xa = p_segments.x0[i];
+		real_t xb = p_segments.x0[i + 1];
+		if (context.xs[context.xs.size() - 1] < xa) {
+			// Flat run before the first point.
+			context.xs.push_back(xa);
+			context.ys.push_back(p_segments.first_y);
+		}
+		if (Math::is_zero_approx(xb - xa)) {
+			// Jump, both values share the offset.
+			context.xs.push_back(xb);
+			context.ys.push_back(p_segments.d[i]);
+			continue;
+		}
+		context.subdivide(i, xa, context.ys[context.ys.size() - 1], xb, context.evaluate(i, xb), 0);
+	}
+	if (context.xs[context.xs.size() - 1] < MAX_X) {
+		context.xs.push_back(MAX_X);
+		context.ys.push_back(p_segments.last_y);
+	}
+
+	// Greedily merge runs that a single chord covers.
+	std::shared_ptr<BakedCache> cache = std::make_shared<BakedCache>();
+	LocalVector<real_t> xs;
+	LocalVector<real_t> ys;
+	const int sample_count = context.xs.size();
+	int anchor = 0;
+	xs.push_back(context.xs[0]);
+	ys.push_back(context.ys[0]);
+	while (anchor < sample_count - 1) {
+		int end = anchor + 1;
+		for (int candidate = end + 1; candidate < sample_count && candidate - anchor <= ADAPTIVE_BAKE_MAX_MERGE; ++candidate) {
+			if (!context.chord_fits(anchor, candidate)) {
+				break;
+			}
+			end = candidate;
+		}
+		xs.push_back(context.xs[end]);
+		ys.push_back(context.ys[end]);
+		anchor = end;
+	}
+
+	const int count = xs.size();
+	cache->offsets.resize(count);
+	cache->values.resize(count);
+	memcpy(cache->offsets.ptrw(), xs.ptr(), count * sizeof(real_t));
+	memcpy(cache->values.ptrw(), ys.ptr(), count * sizeof(real_t));
+
+	// Roughly one value per bucket.
+	const int bucket_count = next_power_of_2(MAX(count, 16));
+	cache->index.resize(bucket_count);
+	int32_t *index = cache->index.ptrw();
+	int i = 0;
+	for (int bucket = 0; bucket < bucket_count; ++bucket) {
+		real_t x = MIN_X + bucket / static_cast<real_t>(bucket_count);
+		while (i + 1 < count && xs[i + 1] <= x) {
+			++i;
+		}
+		index[bucket] = i;
+	}
+
+	return cache;
+}
+
+BetterCurve::SegmentsRef BetterCurve::get_segments() const {
+	return std::atomic_load_explicit(&_segments, std::memory_order_acquire);
+}
+
+void BetterCurve::_update_segments() {
+	std::unique_lock<std::mutex> lock(_update_param_mutex);
+	// Published under the lock, so that the bake always finds segments matching the dirty interval.
+	std::atomic_store_explicit(&_segments, _build_segments(_points), std::memory_order_release);
+	_segments_version.fetch_add(1, std::memory_order_release);
+
+	_bake_dirty_from = MIN(_bake_dirty_from, _edit_dirty_from);
+	_bake_dirty_to = MAX(_bake_dirty_to, _edit_dirty_to);
+	_edit_dirty_from = MAX_X;
+	_edit_dirty_to = MIN_X;
 }
 
-real_t BetterCurve::_sample_local_nocheck(int p_index, real_t p_local_offset, const Vector<Point> &points) {
-	const Point a = points[p_index];
-	const Point b = points[p_index + 1];
+void BetterCurve::_mark_dirty(real_t p_from, real_t p_to) {
+	_edit_dirty_from = MIN(_edit_dirty_from, p_from);
+	_edit_dirty_to = MAX(_edit_dirty_to, p_to);
+}
+
+void BetterCurve::_mark_point_dirty(int p_index) {
+	// A point, and the tangents update_auto_tangents() may change, only shape its two neighbouring segments.
+	// Before the first point and after the last one, the curve is flat at their value.
+	_mark_dirty(p_index > 0 ? _points.x[p_index - 1] : MIN_X,
+			p_index + 1 < _points.size() ? _points.x[p_index + 1] : MAX_X);
+}
+
+BetterCurve::SegmentsRef BetterCurve::_build_segments(const Points &p_points) {
+	std::shared_ptr<Segments> segments = std::make_shared<Segments>();
+	const int point_count = p_points.size();
+	if (point_count == 0) {
+		return segments;
+	}
+
+	segments->first_y = p_points.y[0];
+	segments->last_y = p_points.y[point_count - 1];
+
+	// Shares the offsets' buffer.
+	segments->x0 = p_points.x;
+	const real_t *x0 = segments->x0.ptr();
+	const real_t *ys = p_points.y.ptr();
+	const real_t *left_tangents = p_points.left_tangent.ptr();
+	const real_t *right_tangents = p_points.right_tangent.ptr();
+
+	const int segment_count = point_count - 1;
+	segments->inv_width.resize(segment_count);
+	segments->a.resize(segment_count);
+	segments->b.resize(segment_count);
+	segments->c.resize(segment_count);
+	segments->d.resize(segment_count);
+	segments->kind.resize(segment_count);
+	real_t *inv_width = segments->inv_width.ptrw();
+	real_t *a = segments->a.ptrw();
+	real_t *b = segments->b.ptrw();
+	real_t *c = segments->c.ptrw();
+	real_t *d = segments->d.ptrw();
+	uint8_t *kind = segments->kind.ptrw();
+
+	for (int i = 0; i < segment_count; ++i) {
+		// Same control points as _sample_local_nocheck(), expanded from the Bernstein basis.
+		real_t width = x0[i + 1] - x0[i];
+		if (Math::is_zero_approx(width)) {
+			inv_width[i] = 0;
+			a[i] = 0;
+			b[i] = 0;
+			c[i] = 0;
+			d[i] = ys[i + 1];
+			kind[i] = Segments::KIND_CONSTANT;
+			continue;
+		}
+		const real_t p0 = ys[i];
+		const real_t p1 = ys[i] + width / 3.0 * right_tangents[i];
+		const real_t p2 = ys[i + 1] - width / 3.0 * left_tangents[i + 1];
+		const real_t p3 = ys[i + 1];
+
+		inv_width[i] = 1.0 / width;
+		if (p_points.get_right_mode(i) == TANGENT_LINEAR && p_points.get_left_mode(i + 1) == TANGENT_LINEAR) {
+			// Both tangents follow the chord, so the cubic is exactly the lerp, without its rounding.
+			a[i] = 0;
+			b[i] = 0;
+			c[i] = p3 - p0;
+		} else {
+			a[i] = p3 - p0 + 3.0 * (p1 - p2);
+			b[i] = 3.0 * (p0 - 2.0 * p1 + p2);
+			c[i] = 3.0 * (p1 - p0);
+		}
+		d[i] = p0;
+		if (a[i] != 0 || b[i] != 0) {
+			kind[i] = Segments::KIND_CUBIC;
+		} else {
+			kind[i] = c[i] != 0 ? Segments::KIND_LINEAR : Segments::KIND_CONSTANT;
+		}
+	}
+
+	// Leaves first, then every node from the bottom up.
+	segments->tree_min.resize(2 * segment_count);
+	segments->tree_max.resize(2 * segment_count);
+	real_t *tree_min = segments->tree_min.ptrw();
+	real_t *tree_max = segments->tree_max.ptrw();
+	for (int i = 0; i < segment_count; ++i) {
+		real_t lo = Math_INF;
+		real_t hi = -Math_INF;
+		segments->get_segment_bounds(i, 0, 1, lo, hi);
+		tree_min[segment_count + i] = lo;
+		tree_max[segment_count + i] = hi;
+	}
+	for (int i = segment_count - 1; i > 0; --i) {
+		tree_min[i] = MIN(tree_min[2 * i], tree_min[2 * i + 1]);
+		tree_max[i] = MAX(tree_max[2 * i], tree_max[2 * i + 1]);
+	}
+
+	segments->prefix.resize(point_count);
+	real_t *prefix = segments->prefix.ptrw();
+	prefix[0] = segments->first_y * (x0[0] - MIN_X);
+	for (int i = 0; i < segment_count; ++i) {
+		prefix[i + 1] = prefix[i] + (x0[i + 1] - x0[i]) * (a[i] / 4 + b[i] / 3 + c[i] / 2 + d[i]);
+	}
+
+	// As many buckets as segments, and bucket k starts with the last segment whose bucket is before k.
+	// Buckets are computed the same way as in find(), so rounding can't put an offset outside of its range.
+	if (segment_count >= Segments::GRID_MIN_SEGMENTS) {
+		const int bucket_count = segment_count;
+		segments->grid_scale = bucket_count / (real_t)(MAX_X - MIN_X);
+		segments->grid.resize(bucket_count + 1);
+		int32_t *grid = segments->grid.ptrw();
+		int i = 0;
+		for (int k = 0; k <= bucket_count; ++k) {
+			while (i + 1 < segment_count && segments->get_bucket(x0[i + 1]) < k) {
+				++i;
+			}
+			grid[k] = i;
+		}
+	}
+
+	return segments;
+}
+
+int BetterCurve::Segments::find(real_t p_x) const {
+	// Last segment starting at or before p_x.
+	if (grid.is_empty()) {
+		return find_last_at_or_before(x0.ptr(), get_count(), p_x);
+	}
+	const int k = get_bucket(p_x);
+	const int from = grid[k];
+	return from + find_last_at_or_before(x0.ptr() + from, grid[k + 1] - from + 1, p_x);
+}
+
+real_t BetterCurve::Segments::sample(real_t p_x) const {
+	const int segment_count = get_count();
+	if (segment_count == 0 || p_x <= x0[0]) {
+		return first_y;
+	}
+	if (p_x >= x0[segment_count]) {
+		return last_y;
+	}
+	const int i = find(p_x);
+	return evaluate(i, p_x - x0[i]);
+}
+
+real_t BetterCurve::Segments::derivative(real_t p_x) const {
+	const int segment_count = get_count();
+	if (segment_count == 0 || p_x < x0[0] || p_x > x0[segment_count]) {
+		return 0;
+	}
+	const int i = find(p_x);
+	// dy/dx = dy/dt * dt/dx, zero width segments have no slope.
+	const real_t t = (p_x - x0[i]) * inv_width[i];
+	return ((3 * a[i] * t + 2 * b[i]) * t + c[i]) * inv_width[i];
+}
+
+void BetterCurve::Segments::get_segment_bounds(int p_index, real_t p_t0, real_t p_t1, real_t &r_min, real_t &r_max) const {
+	const real_t t0 = CLAMP(p_t0, (real_t)0, (real_t)1);
+	const real_t t1 = CLAMP(p_t1, (real_t)0, (real_t)1);
+	const real_t ca = a[p_index];
+	const real_t cb = b[p_index];
+	const real_t cc = c[p_index];
+	const real_t cd = d[p_index];
+
+	// The extrema are at the ends or where 3at² + 2bt + c = 0.
+	real_t ts[4] = { t0, t1, -1, -1 };
+	if (!Math::is_zero_approx(ca)) {
+		const real_t discriminant = cb * cb - 3 * ca * cc;
+		if (discriminant >= 0) {
+			const real_t root = Math::sqrt(discriminant);
+			ts[2] = (-cb + root) / (3 * ca);
+			ts[3] = (-cb - root) / (3 * ca);
+		}
+	} else if (!Math::is_zero_approx(cb)) {
+		ts[2] = -cc / (2 * cb);
+	}
+
+	for (int k = 0; k < 4; ++k) {
+		const real_t t = ts[k];
+		if (t < t0 || t > t1) {
+			continue;
+		}
+		const real_t y = ((ca * t + cb) * t + cc) * t + cd;
+		r_min = MIN(r_min, y);
+		r_max = MAX(r_max, y);
+	}
+}
+
+Vector2 BetterCurve::Segments::get_bounds(real_t p_from, real_t p_to) const {
+	if (p_from > p_to) {
+		SWAP(p_from, p_to);
+	}
+	const int segment_count = get_count();
+	if (segment_count == 0) {
+		return Vector2(first_y, first_y);
+	}
+
+	real_t lo = Math_INF;
+	real_t hi = -Math_INF;
+	// Flat before the first point and after the last one.
+	if (p_from <= x0[0]) {
+		lo = MIN(lo, first_y);
+		hi = MAX(hi, first_y);
+	}
+	if (p_to >= x0[segment_count]) {
+		lo = MIN(lo, last_y);
+		hi = MAX(hi, last_y);
+	}
+
+	const real_t from = MAX(p_from, x0[0]);
+	const real_t to = MIN(p_to, x0[segment_count]);
+	if (from <= to) {
+		// The segments at both ends are partially covered, the ones in between come from the tree.
+		const int first = find(from);
+		const int last = find(to);
+		const real_t t0 = (from - x0[first]) * inv_width[first];
+		const real_t t1 = (to - x0[last]) * inv_width[last];
+		if (first == last) {
+			get_segment_bounds(first, t0, t1, lo, hi);
+		} else {
+			get_segment_bounds(first, t0, 1, lo, hi);
+			get_segment_bounds(last, 0, t1, lo, hi);
+			const real_t *tree_lo = tree_min.ptr();
+			const real_t *tree_hi = tree_max.ptr();
+			for (int l = first + 1 + segment_count, r = last + segment_count; l < r; l >>= 1, r >>= 1) {
+				if (l & 1) {
+					lo = MIN(lo, tree_lo[l]);
+					hi = MAX(hi, tree_hi[l]);
+					++l;
+				}
+				if (r & 1) {
+					--r;
+					lo = MIN(lo, tree_lo[r]);
+					hi = MAX(hi, tree_hi[r]);
+				}
+			}
+		}
+	}
+	return Vector2(lo, hi);
+}
+
+real_t BetterCurve::Segments::integral(real_t p_x) const {
+	const int segment_count = get_count();
+	if (segment_count == 0 || p_x <= x0[0]) {
+		return first_y * (p_x - MIN_X);
+	}
+	if (p_x >= x0[segment_count]) {
+		return prefix[segment_count] + last_y * (p_x - x0[segment_count]);
+	}
+	const int i = find(p_x);
+	// Integral of the cubic over [0, t], scaled back by the segment width, with local = t * width.
+	const real_t local = p_x - x0[i];
+	const real_t t = local * inv_width[i];
+	return prefix[i] + local * (d[i] + t * (c[i] / 2 + t * (b[i] / 3 + t * a[i] / 4)));
+}
+
+int BetterCurve::Segments::get_monotonicity() const {
+	const int segment_count = get_count();
+	const real_t rise = last_y - first_y;
+	if (segment_count == 0 || Math::is_zero_approx(rise)) {
+		return 0;
+	}
+	const int direction = rise > 0 ? 1 : -1;
+
+	real_t start = first_y;
+	for (int i = 0; i < segment_count; ++i) {
+		if (inv_width[i] == 0) {
+			// Zero width segments are jumps from the previous value to d.
+			if ((d[i] - start) * direction < -CMP_EPSILON) {
+				return 0;
+			}
+		} else {
+			// The derivative 3at² + 2bt + c is at its lowest at an end or at its vertex.
+			real_t lowest = MIN(c[i] * direction, (3 * a[i] + 2 * b[i] + c[i]) * direction);
+			if (a[i] != 0) {
+				const real_t vertex = -b[i] / (3 * a[i]);
+				if (vertex > 0 && vertex < 1) {
+					lowest = MIN(lowest, ((3 * a[i] * vertex + 2 * b[i]) * vertex + c[i]) * direction);
+				}
+			}
+			if (lowest < -CMP_EPSILON) {
+				return 0;
+			}
+		}
+		start = a[i] + b[i] + c[i] + d[i];
+	}
+	return direction;
+}
+
+real_t BetterCurve::Segments::solve(real_t p_y, int p_monotonicity) const {
+	const int segment_count = get_count();
+	// Everything is compared along the direction of the curve, so that it's non-decreasing.
+	const real_t direction = p_monotonicity < 0 ? -1 : 1;
+	const real_t y = MIN(p_y * direction, last_y * direction);
+	if (segment_count == 0 || y <= first_y * direction) {
+		return MIN_X;
+	}
+
+	// First segment ending at or above p_y.
+	int imin = 0;
+	int imax = segment_count - 1;
+	while (imin < imax) {
+		const int m = (imin + imax) / 2;
+		if ((a[m] + b[m] + c[m] + d[m]) * direction >= y) {
+			imax = m;
+		} else {
+			imin = m + 1;
+		}
+	}
+	if (inv_width[imin] == 0) {
+		return x0[imin];
+	}
+
+	// Smallest t reaching p_y, reached within float precision well before the iterations run out.
+	real_t lo = 0;
+	real_t hi = 1;
+	for (int k = 0; k < 32; ++k) {
+		const real_t t = (lo + hi) * 0.5;
+		if ((((a[imin] * t + b[imin]) * t + c[imin]) * t + d[imin]) * direction >= y) {
+			hi = t;
+		} else {
+			lo = t;
+		}
+	}
+	return x0[imin] + hi / inv_width[imin];
+}
+
+real_t BetterCurve::Cursor::sample(real_t p_offset) {
+	if (!segments) {
+		return 0;
+	}
+	const Segments &s = *segments;
+	const int segment_count = s.get_count();
+	if (segment_count == 0 || p_offset <= s.x0[0]) {
+		return s.first_y;
+	}
+	if (p_offset >= s.x0[segment_count]) {
+		return s.last_y;
+	}
+
+	// Both bounds checks above guarantee the walks stop within the segments.
+	const real_t *x0 = s.x0.ptr();
+	if (index >= segment_count) {
+		index = segment_count - 1;
+	}
+	int steps = 0;
+	if (p_offset >= x0[index]) {
+		while (x0[index + 1] <= p_offset) {
+			++index;
+			if (++steps == MAX_WALK) {
+				index = s.find(p_offset);
+				break;
+			}
+		}
+	} else {
+		while (x0[index] > p_offset) {
+			--index;
+			if (++steps == MAX_WALK) {
+				index = s.find(p_offset);
+				break;
+			}
+		}
+	}
+
+	return s.evaluate(index, p_offset - x0[index]);
+}
+
+real_t BetterCurve::sample_exact(real_t p_offset) const {
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		return 0;
+	}
+	return segments->sample(p_offset);
+}
+
+static String shader_float(real_t p_value) {
+	// Shader literals without a decimal point are integers.
+	String s = String::num(p_value, 9);
+	if (!s.contains(".")) {
+		s += ".0";
+	}
+	return s;
+}
+
+String BetterCurve::to_shader_function(const String &p_name) const {
+	ERR_FAIL_COND_V_MSG(!p_name.is_valid_identifier(), String(), vformat("Invalid shader function name: \"%s\".", p_name));
+
+	SegmentsRef segments = get_segments();
+	if (!segments) {
+		segments = _build_segments(_points);
+	}
+	const Segments &s = *segments;
+	const int segment_count = s.get_count();
+
+	String code = "float " + p_name + "(float x) {\n";
+	if (segment_count == 0) {
+		code += "\treturn " + shader_float(s.first_y) + ";\n}\n";
+		return code;
+	}
+
+	// Segments are picked with step() and mix() instead of branches, the last one starting at or before x wins like in Segments::find().
+	code += vformat("\tvec4 k = vec4(%s, %s, %s, %s);\n", shader_float(s.a[0]), shader_float(s.b[0]), shader_float(s.c[0]), shader_float(s.d[0]));
+	code += vformat("\tvec2 s = vec2(%s, %s);\n", shader_float(s.x0[0]), shader_float(s.inv_width[0]));
+	if (segment_count > 1) {
+		code += "\tfloat m;\n";
+	}
+	for (int i = 1; i < segment_count; ++i) {
+		code += vformat("\tm = step(%s, x);\n", shader_float(s.x0[i]));
+		code += vformat("\tk = mix(k, vec4(%s, %s, %s, %s), m);\n", shader_float(s.a[i]), shader_float(s.b[i]), shader_float(s.c[i]), shader_float(s.d[i]));
+		code += vformat("\ts = mix(s, vec2(%s, %s), m);\n", shader_float(s.x0[i]), shader_float(s.inv_width[i]));
+	}
+	// Clamping t past the last point gives the last value, only the flat part before the first point needs its own case.
+	code += "\tfloat t = clamp((x - s.x) * s.y, 0.0, 1.0);\n";
+	code += vformat("\treturn mix(%s, ((k.x * t + k.y) * t + k.z) * t + k.w, 1.0 - step(x, %s));\n", shader_float(s.first_y), shader_float(s.x0[0]));
+	code += "}\n";
+	return code;
+}
+
+real_t BetterCurve::sample_local_nocheck(int p_index, real_t p_local_offset) const {
+	return _sample_local_nocheck(p_index, p_local_offset, _points);
+}
+
+real_t BetterCurve::_sample_local_nocheck(int p_index, real_t p_local_offset, const Points &points) {
+	const Point a = points.get(p_index);
+	const Point b = points.get(p_index + 1);
 
 	/* Cubic bézier
 	 *
@@ -733,6 +2431,10 @@ real_t BetterCurve::_sample_local_nocheck(int p_index, real_t p_local_offset, co
 		return b.position.y;
 	}
 	p_local_offset /= d;
+	// Tangents following the chord reduce the cubic to a lerp, like in the segments.
+	if (a.right_mode == TANGENT_LINEAR && b.left_mode == TANGENT_LINEAR) {
+		return Math::lerp(a.position.y, b.position.y, p_local_offset);
+	}
 	d /= 3.0;
 	real_t yac = a.position.y + d * a.right_tangent;
 	real_t ybc = b.position.y - d * b.left_tangent;
@@ -3,15 +3,18 @@
 
 #include "core/io/resource.h"
 #include "core/object/object.h"
-#include "core/os/thread.h"
+#include "core/templates/local_vector.h"
 
+#include <atomic>
+#include <memory>
 #include <mutex>
-#include <shared_mutex>
 
 // y(x) curve
 class BetterCurve : public Resource {
 	GDCLASS(BetterCurve, Resource);
 
+	friend class BetterCurveBakeScheduler;
+
 public:
 	static const int MIN_X = 0.f;
 	static const int MAX_X = 1.f;
@@ -19,6 +22,9 @@ public:
 	static const char *SIGNAL_RANGE_CHANGED;
 	static const char *SIGNAL_BAKED;
 
+	// Default time without edits before the curve is re-baked, so that interactive edits are coalesced.
+	static const int DEFAULT_BAKE_DEBOUNCE_MS = 50;
+
 	enum TangentMode {
 		TANGENT_FREE = 0,
 		TANGENT_LINEAR,
@@ -48,6 +54,150 @@ public:
 		}
 	};
 
+	// When the table is re-baked after an edit.
+	enum BakeMode {
+		BAKE_MODE_ASYNC = 0, // On the bake scheduler, once the debounce delay passed.
+		BAKE_MODE_SYNC, // Right away, before the edit returns.
+		BAKE_MODE_LAZY, // By the first sample after the edit. SIGNAL_BAKED waits for it too.
+		BAKE_MODE_COUNT
+	};
+
+	// Storage of uniform baked tables. Adaptive tables are always kept at full precision.
+	enum BakePrecision {
+		BAKE_PRECISION_FULL = 0, // real_t
+		BAKE_PRECISION_HALF, // 16-bit float
+		BAKE_PRECISION_UNORM16, // 16-bit normalized to [min_value, max_value], values outside are clamped
+		BAKE_PRECISION_COUNT
+	};
+
+	// Immutable baked table. A new one is built off to the side on every bake and
+	// published as a whole, so readers never wait for the baker or for each other.
+	struct BakedCache {
+		Vector<real_t> values;
+		// Adaptive bakes only: offset of each value, and for each of the index.size() uniform
+		// buckets of [MIN_X, MAX_X], the last value at or before the bucket start.
+		Vector<real_t> offsets;
+		Vector<int32_t> index;
+		// Replaces values when precision isn't full. UNORM16 decodes as q * scale + bias.
+		BakePrecision precision = BAKE_PRECISION_FULL;
+		Vector<uint16_t> quantized;
+		real_t scale = 1.0;
+		real_t bias = 0.0;
+		// With bake_inverse: x for uniform values from first_y to last_y, empty if the curve isn't monotone.
+		bool inverse_baked = false;
+		Vector<real_t> inverse;
+		real_t inverse_from = 0.0;
+		real_t inverse_scale = 0.0;
+		// With bake_integral: integral from MIN_X and value at each uniform offset, interleaved.
+		bool integral_baked = false;
+		Vector<real_t> integral;
+
+		bool is_adaptive() const { return !offsets.is_empty(); }
+		int get_count() const { return precision == BAKE_PRECISION_FULL ? values.size() : quantized.size(); }
+		real_t get_value(int p_index) const;
+		real_t sample(real_t p_offset) const;
+		void sample_n(const real_t *p_offsets, real_t *r_values, int p_count) const;
+		// Needs a non-empty inverse.
+		real_t sample_inverse(real_t p_value) const;
+		// Integral from MIN_X to p_offset, needs a non-empty integral.
+		real_t sample_integral(real_t p_offset) const;
+
+		// Whether this table is stored the way a bake with these settings would store it.
+		bool has_precision(BakePrecision p_precision, real_t p_min, real_t p_max) const;
+		void set_precision(BakePrecision p_precision, real_t p_min, real_t p_max);
+		// Encodes p_values[p_from..p_to] into the same indices of quantized, which must be sized already.
+		void encode(int p_from, int p_to, const real_t *p_values);
+		uint64_t get_memory_usage() const;
+
+	private:
+		real_t _sample_adaptive(real_t p_offset) const;
+	};
+	typedef std::shared_ptr<const BakedCache> BakedCacheRef;
+
+	// Power basis coefficients of every segment, rebuilt whenever the points change:
+	// y = ((a * t + b) * t + c) * t + d, with t = (x - x0) * inv_width.
+	struct Segments {
+		// What the cubic of a segment reduces to, each with its own evaluation kernel.
+		enum Kind : uint8_t {
+			KIND_CONSTANT, // d
+			KIND_LINEAR, // c * t + d
+			KIND_CUBIC,
+		};
+
+		Vector<real_t> x0; // One entry per point, the last one is where the last segment ends.
+		Vector<real_t> inv_width;
+		Vector<real_t> a;
+		Vector<real_t> b;
+		Vector<real_t> c;
+		Vector<real_t> d;
+		Vector<uint8_t> kind;
+		Vector<real_t> prefix; // Integral from MIN_X to each x0.
+		// Segment trees of the exact min and max of each segment, with segment i at leaf get_count() + i.
+		Vector<real_t> tree_min;
+		Vector<real_t> tree_max;
+		// Lookup grid, only built from GRID_MIN_SEGMENTS segments on. The segment containing an offset
+		// of uniform bucket k of [MIN_X, MAX_X] is one of grid[k] to grid[k + 1].
+		Vector<int32_t> grid;
+		real_t grid_scale = 0.0;
+		real_t first_y = 0.0;
+		real_t last_y = 0.0;
+
+		static const int GRID_MIN_SEGMENTS = 16;
+
+		int get_count() const { return a.size(); }
+		_FORCE_INLINE_ int get_bucket(real_t p_x) const { return CLAMP(static_cast<int>((p_x - MIN_X) * grid_scale), 0, grid.size() - 2); }
+		// Index of the segment containing p_x, clamped to the existing ones. Needs at least one segment.
+		int find(real_t p_x) const;
+		real_t sample(real_t p_x) const;
+		real_t derivative(real_t p_x) const;
+		// Exact min and max of the curve over [p_from, p_to], in O(log n).
+		Vector2 get_bounds(real_t p_from, real_t p_to) const;
+		// Grows r_min and r_max to the values of segment p_index for t in [p_t0, p_t1].
+		void get_segment_bounds(int p_index, real_t p_t0, real_t p_t1, real_t &r_min, real_t &r_max) const;
+		// Integral from MIN_X to p_x, the curve being flat before the first point and after the last one.
+		real_t integral(real_t p_x) const;
+		// 1 if the curve never decreases, -1 if it never increases, 0 if neither or if it's constant.
+		int get_monotonicity() const;
+		// Smallest offset where a curve of that monotonicity reaches p_y, clamped to the values it takes.
+		real_t solve(real_t p_y, int p_monotonicity) const;
+
+		template <Kind K>
+		_FORCE_INLINE_ real_t evaluate(int p_index, real_t p_local_offset) const {
+			if constexpr (K == KIND_CONSTANT) {
+				return d.ptr()[p_index];
+			}
+			const real_t t = p_local_offset * inv_width.ptr()[p_index];
+			if constexpr (K == KIND_LINEAR) {
+				return c.ptr()[p_index] * t + d.ptr()[p_index];
+			}
+			return ((a.ptr()[p_index] * t + b.ptr()[p_index]) * t + c.ptr()[p_index]) * t + d.ptr()[p_index];
+		}
+
+		_FORCE_INLINE_ real_t evaluate(int p_index, real_t p_local_offset) const {
+			switch (kind.ptr()[p_index]) {
+				case KIND_CONSTANT:
+					return evaluate<KIND_CONSTANT>(p_index, p_local_offset);
+				case KIND_LINEAR:
+					return evaluate<KIND_LINEAR>(p_index, p_local_offset);
+				default:
+					return evaluate<KIND_CUBIC>(p_index, p_local_offset);
+			}
+		}
+	};
+	typedef std::shared_ptr<const Segments> SegmentsRef;
+
+	// Remembers the last segment, so that offsets moving monotonically are found in amortized O(1).
+	// Samples the segments it holds, refresh them from get_segments() to see later edits.
+	struct Cursor {
+		// Past this many steps from the last segment, walking is given up in favor of a search.
+		static const int MAX_WALK = 8;
+
+		SegmentsRef segments;
+		int index = 0;
+
+		real_t sample(real_t p_offset);
+	};
+
 	BetterCurve();
 
 	~BetterCurve();
@@ -69,6 +219,18 @@ public:
 	void remove_point(int p_index);
 	void clear_points();
 
+	// Replaces all the points at once, sorting them by offset. Empty tangent or mode arrays default to 0 and TANGENT_FREE.
+	void set_points(const PackedVector2Array &p_positions,
+			const PackedFloat32Array &p_left_tangents = PackedFloat32Array(),
+			const PackedFloat32Array &p_right_tangents = PackedFloat32Array(),
+			const PackedInt32Array &p_left_modes = PackedInt32Array(),
+			const PackedInt32Array &p_right_modes = PackedInt32Array());
+
+	// Edits between these only result in one update, change notification and bake, once the outermost commit_edit() is reached.
+	// The transaction belongs to the curve, not to the calling thread: while one is open, edits made from any thread are held back until it's committed.
+	void begin_edit();
+	void commit_edit();
+
 	int get_index(real_t p_offset) const;
 
 	void set_point_value(int p_index, real_t p_position);
@@ -87,6 +249,17 @@ public:
 
 	real_t sample(real_t p_offset) const;
 	real_t sample_local_nocheck(int p_index, real_t p_offset) const;
+	// Evaluates the segments directly instead of the baked cache.
+	real_t sample_exact(real_t p_offset) const;
+
+	// Shader function "float p_name(float x)" evaluating the segments, with their coefficients inlined.
+	// Costs grow with the point count, so it's meant for short curves where a texture fetch would cost more.
+	String to_shader_function(const String &p_name) const;
+
+	// Current segments, safe to keep and read from any thread.
+	SegmentsRef get_segments() const;
+	// Incremented every time the segments are rebuilt.
+	uint32_t get_segments_version() const { return _segments_version.load(std::memory_order_acquire); }
 
 	void clean_dupes();
 
@@ -105,21 +278,115 @@ public:
 	Array get_data() const;
 	void set_data(Array input);
 
+	// Binary form of the points, optionally followed by the baked table so that loaded curves don't need a bake.
+	PackedByteArray get_packed_data() const;
+	void set_packed_data(const PackedByteArray &p_data);
+
+	bool is_storing_baked_cache() const { return _store_baked_cache; }
+	void set_store_baked_cache(bool p_enabled);
+
+	// Curves with identical segments and bake settings then share one baked table, and skip baking when it exists.
+	bool is_sharing_baked_cache() const { return _share_baked_cache; }
+	void set_share_baked_cache(bool p_enabled);
+
+	// Bakes from the current points before returning, taking over any pending bake.
 	void bake();
+	BakeMode get_bake_mode() const { return _bake_mode; }
+	void set_bake_mode(BakeMode p_mode);
 	int get_bake_resolution() const { return _bake_resolution; }
 	void set_bake_resolution(int p_resolution);
 	real_t sample_baked(real_t p_offset) const;
 
+	// Above 0, the bake places its samples so that the error stays below the tolerance, instead of using a uniform resolution.
+	real_t get_bake_tolerance() const { return _bake_tolerance; }
+	void set_bake_tolerance(real_t p_tolerance);
+
+	BakePrecision get_bake_precision() const { return _bake_precision; }
+	void set_bake_precision(BakePrecision p_precision);
+
+	int get_bake_debounce_ms() const { return _bake_debounce_ms; }
+	void set_bake_debounce_ms(int p_debounce_ms);
+
+	// Current snapshot, safe to keep and read from any thread while a re-bake is running.
+	BakedCacheRef get_baked_cache() const;
+	// The snapshot sample() would read, a pending lazy bake is run and a queued one prioritized first.
+	BakedCacheRef get_sampling_cache() const;
+	// Incremented every time a new snapshot is published, derived data only needs a rebuild when it changed.
+	uint32_t get_bake_generation() const { return _bake_generation.load(std::memory_order_acquire); }
+	// Bake instrumentation, updated by every bake regardless of the thread it runs on.
+	uint64_t get_bake_count() const { return _bake_count.load(std::memory_order_relaxed); }
+	uint64_t get_last_bake_usec() const { return _last_bake_usec.load(std::memory_order_relaxed); }
+	double get_average_bake_usec() const;
+	// Edits that joined an already pending bake instead of adding one.
+	uint64_t get_coalesced_update_count() const { return _coalesced_update_count.load(std::memory_order_relaxed); }
+	// Bytes held by the current snapshot, counted in full even when it's shared with other curves.
+	int64_t get_baked_cache_memory_usage() const;
+	// Blocks until the pending bake is published, or p_timeout_ms passed if it's not negative. Returns false on timeout.
+	bool wait_for_bake(int p_timeout_ms = -1);
+
+	// Batched sample_baked(), the snapshot is loaded once for the whole batch.
+	void sample_n(const real_t *p_offsets, real_t *r_values, int p_count) const;
+	PackedFloat32Array sample_array(const PackedFloat32Array &p_offsets) const;
+
+	// With bake_inverse, a table of the offset reaching each value is baked too, if the curve is monotone.
+	// Inverse sampling fails on curves that aren't.
+	bool is_baking_inverse() const { return _bake_inverse; }
+	void set_bake_inverse(bool p_enabled);
+	bool is_monotone() const;
+	// Smallest offset at which the curve reaches p_value.
+	real_t sample_inverse(real_t p_value) const;
+	PackedFloat32Array sample_inverse_array(const PackedFloat32Array &p_values) const;
+
+	// Exact min and max of the curve over [p_from, p_to], as Vector2(min, max).
+	Vector2 get_range_bounds(real_t p_from, real_t p_to) const;
+
+	// Slope of the segments at p_offset, 0 where the curve is flat.
+	real_t sample_derivative(real_t p_offset) const;
+	// Area under the curve from p_from to p_to. Exact in O(log n) from the segments,
+	// or O(1) from a table baked with bake_integral.
+	real_t integrate(real_t p_from, real_t p_to) const;
+	bool is_baking_integral() const { return _bake_integral; }
+	void set_bake_integral(bool p_enabled);
+
 	void ensure_default_setup(real_t p_min, real_t p_max);
 
 	bool _set(const StringName &p_name, const Variant &p_value);
 	bool _get(const StringName &p_name, Variant &r_ret) const;
 	void _get_property_list(List<PropertyInfo> *p_list) const;
 
+	// Called when the module is uninitialized, before StringNames are.
+	static void free_point_property_names();
+
 protected:
 	static void _bind_methods();
 
 private:
+	// Points as parallel arrays, so that searching by offset only loads offsets.
+	struct Points {
+		Vector<real_t> x;
+		Vector<real_t> y;
+		Vector<real_t> left_tangent;
+		Vector<real_t> right_tangent;
+		Vector<uint8_t> modes; // Left mode in the low 4 bits, right mode in the high 4 bits.
+
+		int size() const { return x.size(); }
+		bool is_empty() const { return x.is_empty(); }
+		void resize(int p_size);
+		void clear() { resize(0); }
+		Point get(int p_index) const;
+		void set(int p_index, const Point &p_point);
+		void insert(int p_index, const Point &p_point);
+		void remove_at(int p_index);
+
+		Vector2 get_position(int p_index) const { return Vector2(x[p_index], y[p_index]); }
+		TangentMode get_left_mode(int p_index) const { return (TangentMode)(modes[p_index] & 0x0f); }
+		TangentMode get_right_mode(int p_index) const { return (TangentMode)(modes[p_index] >> 4); }
+		void set_left_mode(int p_index, TangentMode p_mode) { modes.write[p_index] = (modes[p_index] & 0xf0) | p_mode; }
+		void set_right_mode(int p_index, TangentMode p_mode) { modes.write[p_index] = (modes[p_index] & 0x0f) | (p_mode << 4); }
+	};
+
+	// Needs _update_param_mutex held. Returns the index the point was inserted at.
+	int _insert_point(Point p_point);
 	int _add_point(Vector2 p_position,
 			real_t left_tangent = 0,
 			real_t right_tangent = 0,
@@ -128,27 +395,104 @@ private:
 	void _remove_point(int p_index);
 
 	void _queue_update();
-
-	static void _update_bake(void *);
-	static real_t _sample(real_t offset, const Vector<Point> &points, const int idx);
-	static real_t _sample_local_nocheck(int idx, real_t local_offset, const Vector<Point> &points);
-
-	Vector<Point> _points;
+	void _notify_point_count_changed();
+	void _schedule_bake();
+	void _bake_lazy();
+	// Also bakes lazy curves with a pending bake.
+	void _prioritize_bake() const;
+	// Bakes and records how long it took, _rebake_cache() does the actual work.
+	void _bake_now();
+	void _rebake_cache();
+	void _publish_baked_cache(const BakedCacheRef &p_cache);
+	// Emits SIGNAL_BAKED, deferred to the main thread when called from another one.
+	void _notify_baked();
+	void _emit_baked();
+	void _update_segments();
+	// Must be called with _update_param_mutex held.
+	void _mark_dirty(real_t p_from = MIN_X, real_t p_to = MAX_X);
+	void _mark_point_dirty(int p_index);
+
+	static BakedCacheRef _bake_segments(const Segments &p_segments, int p_resolution);
+	static void _bake_segments_range(const Segments &p_segments, int p_resolution, int p_from, int p_to, real_t *r_values);
+	static BakedCacheRef _bake_segments_adaptive(const Segments &p_segments, real_t p_tolerance);
+	static SegmentsRef _build_segments(const Points &p_points);
+	// Returns p_cache with its inverse and integral tables rebuilt, or removed when disabled.
+	static BakedCacheRef _attach_derived_tables(const BakedCacheRef &p_cache, const Segments &p_segments, bool p_inverse, bool p_integral, int p_resolution);
+	static BakedCacheRef _quantize_baked_cache(const BakedCacheRef &p_cache, BakePrecision p_precision, real_t p_min, real_t p_max);
+	static real_t _sample_local_nocheck(int idx, real_t local_offset, const Points &points);
+
+	struct PointPropertyNames {
+		StringName position;
+		StringName left_tangent;
+		StringName left_mode;
+		StringName right_tangent;
+		StringName right_mode;
+
+		PointPropertyNames(int p_index);
+	};
+	// Index of "point_<index>/..." read in place, false for any other name.
+	static bool _parse_point_index(const StringName &p_name, int &r_index);
+	static const PointPropertyNames &_get_point_property_names(int p_index);
+	// Shared by every curve and grown on demand, so each name is only ever built once.
+	static LocalVector<PointPropertyNames *> _point_property_names;
+	static std::mutex _point_property_names_mutex;
+
+	// Cached _get_property_list(), rebuilt when the point count changes.
+	mutable LocalVector<PropertyInfo> _property_list;
+	mutable int _property_list_point_count = -1;
+
+	Points _points;
 	bool _baked_cache_dirty = false;
-	Vector<real_t> _baked_cache;
+	BakedCacheRef _baked_cache; // Only accessed through the std::atomic_* free functions.
+	SegmentsRef _segments; // Same.
+	std::atomic<uint32_t> _segments_version{ 0 };
+	std::atomic<uint32_t> _bake_generation{ 0 };
+	std::atomic<bool> _baked_notification_queued{ false };
+	std::atomic<uint64_t> _bake_count{ 0 };
+	std::atomic<uint64_t> _bake_usec{ 0 };
+	std::atomic<uint64_t> _last_bake_usec{ 0 };
+	std::atomic<uint64_t> _coalesced_update_count{ 0 };
+
+	// Offset intervals, empty while from > to. Guarded by _update_param_mutex.
+	// Edits grow the first one, it's moved to the second when the segments are rebuilt,
+	// and the bake only recomputes the values the second one covers.
+	real_t _edit_dirty_from = MAX_X;
+	real_t _edit_dirty_to = MIN_X;
+	real_t _bake_dirty_from = MAX_X;
+	real_t _bake_dirty_to = MIN_X;
 	int _bake_resolution = 100;
+	real_t _bake_tolerance = 0.0;
+	BakePrecision _bake_precision = BAKE_PRECISION_FULL;
+	bool _store_baked_cache = false;
+	bool _share_baked_cache = false;
+	bool _bake_inverse = false;
+	bool _bake_integral = false;
 	real_t _min_value = 0.0;
 	real_t _max_value = 1.0;
 	int _minmax_set_once = 0b00; // Encodes whether min and max have been set a first time, first bit for min and second for max.
 
-	bool _update_queued{ false };
+	int _bake_debounce_ms = DEFAULT_BAKE_DEBOUNCE_MS;
+	BakeMode _bake_mode = BAKE_MODE_ASYNC;
+
+	// Guarded by _update_param_mutex.
+	int _edit_depth = 0;
+	bool _edit_update_pending = false;
+	bool _edit_point_count_pending = false;
+
+	// Written by BetterCurveBakeScheduler under its own lock.
+	std::atomic<bool> _bake_queued{ false };
+	mutable std::atomic<bool> _bake_prioritized{ false };
+	// Lazy mode only, set while an edit hasn't been baked yet.
+	std::atomic<bool> _bake_pending{ false };
+
+	// Serializes the bakes done outside of the scheduler, which already never bakes a curve twice at once.
+	std::mutex _bake_mutex;
 
-	Thread _update_thread;
-	std::mutex _update_queue_mutex;
 	std::mutex _update_param_mutex;
-	std::shared_mutex _getter_mutex;
 };
 
 VARIANT_ENUM_CAST(BetterCurve::TangentMode)
+VARIANT_ENUM_CAST(BetterCurve::BakeMode)
+VARIANT_ENUM_CAST(BetterCurve::BakePrecision)
 
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+#include "curvature_bake_scheduler.h"
+
+#include "core/os/os.h"
+#include "curvature.h"
+
+#include <chrono>
+
+BetterCurveBakeScheduler *BetterCurveBakeScheduler::singleton = nullptr;
+
+void BetterCurveBakeScheduler::queue(BetterCurve *p_curve, int p_delay_ms) {
+	ERR_FAIL_NULL(p_curve);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		if (_threads.is_empty()) {
+			_start_threads();
+		}
+
+		// A curve has at most one request, later edits only push its deadline back.
+		if (_requests.has(p_curve)) {
+			p_curve->_coalesced_update_count.fetch_add(1, std::memory_order_relaxed);
+		}
+		Request &request = _requests[p_curve];
+		request.due_usec = OS::get_singleton()->get_ticks_usec() + static_cast<uint64_t>(MAX(p_delay_ms, 0)) * 1000;
+		p_curve->_bake_queued.store(true, std::memory_order_relaxed);
+	}
+	_work_cv.notify_one();
+}
+
+void BetterCurveBakeScheduler::prioritize(BetterCurve *p_curve) {
+	ERR_FAIL_NULL(p_curve);
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		Request *request = _requests.getptr(p_curve);
+		if (request == nullptr) {
+			return;
+		}
+		request->priority = true;
+	}
+	_work_cv.notify_one();
+}
+
+void BetterCurveBakeScheduler::cancel(BetterCurve *p_curve) {
+	std::unique_lock<std::mutex> lock(_mutex);
+	if (_requests.erase(p_curve)) {
+		p_curve->_bake_queued.store(false, std::memory_order_relaxed);
+		p_curve->_bake_prioritized.store(false, std::memory_order_relaxed);
+	}
+	_done_cv.wait(lock, [this, p_curve] { return !_running.has(p_curve); });
+}
+
+bool BetterCurveBakeScheduler::wait(BetterCurve *p_curve, int p_timeout_ms) {
+	ERR_FAIL_NULL_V(p_curve, false);
+	std::unique_lock<std::mutex> lock(_mutex);
+	Request *request = _requests.getptr(p_curve);
+	if (request != nullptr) {
+		// Nothing is gained by waiting for the debounce delay.
+		request->priority = true;
+		_work_cv.notify_one();
+	}
+
+	auto baked = [this, p_curve] { return !_requests.has(p_curve) && !_running.has(p_curve); };
+	if (p_timeout_ms < 0) {
+		_done_cv.wait(lock, baked);
+		return true;
+	}
+	return _done_cv.wait_for(lock, std::chrono::milliseconds(p_timeout_ms), baked);
+}
+
+BetterCurve *BetterCurveBakeScheduler::_pop_due_curve(uint64_t p_now, uint64_t &r_wait_usec) {
+	BetterCurve *best = nullptr;
+	const Request *best_request = nullptr;
+	r_wait_usec = UINT64_MAX;
+
+	for (const KeyValue<BetterCurve *, Request> &E : _requests) {
+		// Never bake the same curve on two workers, it'll be picked up again once the running bake is done.
+		if (_running.has(E.key)) {
+			continue;
+		}
+		const Request &request = E.value;
+		if (!request.priority && request.due_usec > p_now) {
+			r_wait_usec = MIN(r_wait_usec, request.due_usec - p_now);
+			continue;
+		}
+		// Prioritized curves first, then the ones that have been waiting the longest.
+		if (best_request == nullptr ||
+				(request.priority && !best_request->priority) ||
+				(request.priority == best_request->priority && request.due_usec < best_request->due_usec)) {
+			best = E.key;
+			best_request = &request;
+		}
+	}
+
+	if (best != nullptr) {
+		_requests.erase(best);
+		best->_bake_queued.store(false, std::memory_order_relaxed);
+		best->_bake_prioritized.store(false, std::memory_order_relaxed);
+	}
+	return best;
+}
+
+void BetterCurveBakeScheduler::_thread_func(void *p_user) {
+	BetterCurveBakeScheduler *scheduler = reinterpret_cast<BetterCurveBakeScheduler *>(p_user);
+
+	std::unique_lock<std::mutex> lock(scheduler->_mutex);
+	while (!scheduler->_exit) {
+		uint64_t wait_usec = 0;
+		BetterCurve *curve = scheduler->_pop_due_curve(OS::get_singleton()->get_ticks_usec(), wait_usec);
+		if (curve == nullptr) {
+			if (wait_usec == UINT64_MAX) {
+				scheduler->_work_cv.wait(lock);
+			} else {
+				scheduler->_work_cv.wait_for(lock, std::chrono::microseconds(wait_usec));
+			}
+			continue;
+		}
+
+		scheduler->_running.insert(curve);
+		lock.unlock();
+
+		curve->_bake_now();
+
+		lock.lock();
+		if (!scheduler->_requests.has(curve)) {
+			// Only notify once the most recent edit made it into the cache.
+			// The curve is still marked as running, so it can't be freed meanwhile, the signal itself is deferred.
+			curve->_notify_baked();
+		}
+		scheduler->_running.erase(curve);
+		scheduler->_done_cv.notify_all();
+		// The curve may have been queued again while it was baking.
+		scheduler->_work_cv.notify_one();
+	}
+}
+
+void BetterCurveBakeScheduler::_start_threads() {
+	_threads.resize(_thread_count);
+	for (int i = 0; i < _thread_count; ++i) {
+		_threads[i] = memnew(Thread);
+		_threads[i]->start(BetterCurveBakeScheduler::_thread_func, this);
+	}
+}
+
+BetterCurveBakeScheduler::BetterCurveBakeScheduler(int p_thread_count) {
+	singleton = this;
+	// Threads are only started by the first request, and bounded by the core count rather than the curve count.
+	_thread_count = p_thread_count > 0 ? p_thread_count : MAX(1, OS::get_singleton()->get_processor_count() - 1);
+}
+
+BetterCurveBakeScheduler::~BetterCurveBakeScheduler() {
+	{
+		std::lock_guard<std::mutex> lock(_mutex);
+		_exit = true;
+		_requests.clear();
+	}
+	_work_cv.notify_all();
+
+	for (Thread *thread : _threads) {
+		thread->wait_to_finish();
+		memdelete(thread);
+	}
+	_threads.clear();
+
+	if (singleton == this) {
+		singleton = nullptr;
+	}
+}
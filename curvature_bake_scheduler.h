@@ -0,0 +1,60 @@
+#ifndef CURVATURE_BAKE_SCHEDULER_H
+#define CURVATURE_BAKE_SCHEDULER_H
+
+#include "core/os/thread.h"
+#include "core/templates/hash_map.h"
+#include "core/templates/hash_set.h"
+#include "core/templates/local_vector.h"
+
+#include <condition_variable>
+#include <mutex>
+
+class BetterCurve;
+
+// Bakes dirty curves on a small pool of threads shared by all BetterCurve instances.
+// Repeated requests for the same curve are coalesced into a single pending bake.
+class BetterCurveBakeScheduler {
+public:
+	static BetterCurveBakeScheduler *get_singleton() { return singleton; }
+
+	// Bakes p_curve once p_delay_ms passed without another request for it.
+	void queue(BetterCurve *p_curve, int p_delay_ms);
+	// Skips the remaining delay of a queued curve and puts it ahead of the others.
+	void prioritize(BetterCurve *p_curve);
+	// Drops the pending request of p_curve and waits for a running bake of it to finish.
+	void cancel(BetterCurve *p_curve);
+	// Bakes p_curve without delay, and waits until neither queued nor running. Returns false if p_timeout_ms passed first.
+	bool wait(BetterCurve *p_curve, int p_timeout_ms);
+
+	int get_thread_count() const { return _thread_count; }
+
+	BetterCurveBakeScheduler(int p_thread_count = -1);
+	~BetterCurveBakeScheduler();
+
+private:
+	static BetterCurveBakeScheduler *singleton;
+
+	struct Request {
+		uint64_t due_usec = 0;
+		bool priority = false;
+	};
+
+	static void _thread_func(void *p_user);
+	void _start_threads();
+	// Must be called with _mutex held. Returns nullptr and the time to wait if nothing is due yet.
+	BetterCurve *_pop_due_curve(uint64_t p_now, uint64_t &r_wait_usec);
+
+	int _thread_count = 1;
+	LocalVector<Thread *> _threads;
+
+	// Guarded by _mutex.
+	HashMap<BetterCurve *, Request> _requests;
+	HashSet<BetterCurve *> _running;
+	bool _exit = false;
+
+	std::mutex _mutex;
+	std::condition_variable _work_cv;
+	std::condition_variable _done_cv;
+};
+
+#endif // CURVATURE_BAKE_SCHEDULER_H
@@ -0,0 +1,161 @@
+#include "curvature_cache_interner.h"
+
+#include "core/templates/hashfuncs.h"
+
+BetterCurveCacheInterner *BetterCurveCacheInterner::singleton = nullptr;
+
+BetterCurveCacheInterner::Key::Key(const BetterCurve::SegmentsRef &p_segments, int p_resolution, real_t p_tolerance, BetterCurve::BakePrecision p_precision, real_t p_min, real_t p_max, bool p_inverse, bool p_integral) {
+	segments = p_segments;
+	tolerance = p_tolerance;
+	inverse = p_inverse;
+	integral = p_integral;
+	// Settings that don't affect the table are left out, so they don't prevent sharing.
+	// Adaptive tables don't depend on the resolution, but their derived tables do.
+	resolution = p_tolerance > 0 && !p_inverse && !p_integral ? 0 : p_resolution;
+	precision = p_tolerance > 0 ? BetterCurve::BAKE_PRECISION_FULL : p_precision;
+	if (precision == BetterCurve::BAKE_PRECISION_UNORM16) {
+		min_value = p_min;
+		max_value = p_max;
+	}
+}
+
+static uint32_t hash_reals(const Vector<real_t> &p_values, uint32_t p_hash) {
+	return hash_murmur3_buffer(p_values.ptr(), p_values.size() * sizeof(real_t), p_hash);
+}
+
+static bool equal_reals(const Vector<real_t> &p_a, const Vector<real_t> &p_b) {
+	if (p_a.size() != p_b.size()) {
+		return false;
+	}
+	const real_t *a = p_a.ptr();
+	const real_t *b = p_b.ptr();
+	for (int i = 0; i < p_a.size(); ++i) {
+		if (a[i] != b[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t BetterCurveCacheInterner::_hash(const Key &p_key) {
+	const BetterCurve::Segments &s = *p_key.segments;
+	uint32_t h = hash_murmur3_one_32(p_key.resolution);
+	h = hash_murmur3_one_real(p_key.tolerance, h);
+	h = hash_murmur3_one_32(p_key.precision, h);
+	h = hash_murmur3_one_real(p_key.min_value, h);
+	h = hash_murmur3_one_real(p_key.max_value, h);
+	h = hash_murmur3_one_32(p_key.inverse, h);
+	h = hash_murmur3_one_32(p_key.integral, h);
+	h = hash_murmur3_one_real(s.first_y, h);
+	h = hash_murmur3_one_real(s.last_y, h);
+	// inv_width follows from x0.
+	h = hash_reals(s.x0, h);
+	h = hash_reals(s.a, h);
+	h = hash_reals(s.b, h);
+	h = hash_reals(s.c, h);
+	h = hash_reals(s.d, h);
+	return hash_fmix32(h);
+}
+
+bool BetterCurveCacheInterner::_matches(const Key &p_a, const Key &p_b) {
+	if (p_a.resolution != p_b.resolution || p_a.tolerance != p_b.tolerance || p_a.precision != p_b.precision ||
+			p_a.min_value != p_b.min_value || p_a.max_value != p_b.max_value || p_a.inverse != p_b.inverse || p_a.integral != p_b.integral) {
+		return false;
+	}
+	if (p_a.segments == p_b.segments) {
+		return true;
+	}
+	// Full comparison, so that hash collisions never share a table.
+	const BetterCurve::Segments &a = *p_a.segments;
+	const BetterCurve::Segments &b = *p_b.segments;
+	return a.first_y == b.first_y && a.last_y == b.last_y &&
+			equal_reals(a.x0, b.x0) && equal_reals(a.inv_width, b.inv_width) &&
+			equal_reals(a.a, b.a) && equal_reals(a.b, b.b) && equal_reals(a.c, b.c) && equal_reals(a.d, b.d);
+}
+
+BetterCurve::BakedCacheRef BetterCurveCacheInterner::find(const Key &p_key) {
+	ERR_FAIL_COND_V(!p_key.segments, BetterCurve::BakedCacheRef());
+	const uint32_t hash = _hash(p_key);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	LocalVector<Entry> *bucket = _entries.getptr(hash);
+	if (bucket == nullptr) {
+		return BetterCurve::BakedCacheRef();
+	}
+	for (const Entry &entry : *bucket) {
+		if (_matches(entry.key, p_key)) {
+			return entry.cache.lock();
+		}
+	}
+	return BetterCurve::BakedCacheRef();
+}
+
+BetterCurve::BakedCacheRef BetterCurveCacheInterner::intern(const Key &p_key, const BetterCurve::BakedCacheRef &p_cache) {
+	ERR_FAIL_COND_V(!p_key.segments, p_cache);
+	ERR_FAIL_COND_V(!p_cache, p_cache);
+	const uint32_t hash = _hash(p_key);
+
+	std::lock_guard<std::mutex> lock(_mutex);
+	LocalVector<Entry> &bucket = _entries[hash];
+	for (Entry &entry : bucket) {
+		if (!_matches(entry.key, p_key)) {
+			continue;
+		}
+		BetterCurve::BakedCacheRef existing = entry.cache.lock();
+		if (existing) {
+			return existing;
+		}
+		// Same content, but every curve using it moved on since.
+		entry.cache = p_cache;
+		return p_cache;
+	}
+
+	Entry entry;
+	entry.key = p_key;
+	entry.cache = p_cache;
+	bucket.push_back(entry);
+	++_entry_count;
+
+	// Amortized, expired entries are swept once the insertions since the last sweep outnumber half the entries.
+	if (++_insertions_since_sweep > MAX(_entry_count / 2, 64)) {
+		_sweep();
+	}
+	return p_cache;
+}
+
+void BetterCurveCacheInterner::_sweep() {
+	LocalVector<uint32_t> empty_buckets;
+	for (KeyValue<uint32_t, LocalVector<Entry>> &E : _entries) {
+		LocalVector<Entry> &bucket = E.value;
+		for (uint32_t i = 0; i < bucket.size();) {
+			if (bucket[i].cache.expired()) {
+				bucket.remove_at_unordered(i);
+				--_entry_count;
+			} else {
+				++i;
+			}
+		}
+		if (bucket.is_empty()) {
+			empty_buckets.push_back(E.key);
+		}
+	}
+	for (uint32_t hash : empty_buckets) {
+		_entries.erase(hash);
+	}
+	_insertions_since_sweep = 0;
+}
+
+int BetterCurveCacheInterner::get_entry_count() {
+	std::lock_guard<std::mutex> lock(_mutex);
+	return _entry_count;
+}
+
+BetterCurveCacheInterner::BetterCurveCacheInterner() {
+	singleton = this;
+}
+
+BetterCurveCacheInterner::~BetterCurveCacheInterner() {
+	if (singleton == this) {
+		singleton = nullptr;
+	}
+}
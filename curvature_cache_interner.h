@@ -0,0 +1,64 @@
+#ifndef CURVATURE_CACHE_INTERNER_H
+#define CURVATURE_CACHE_INTERNER_H
+
+#include "core/templates/hash_map.h"
+#include "core/templates/local_vector.h"
+#include "curvature.h"
+
+#include <memory>
+#include <mutex>
+
+// Process-wide table of baked caches keyed by the content they were baked from,
+// so that curves with identical segments and bake settings share one immutable snapshot.
+// Only weak references to the tables are kept, they live as long as a curve publishes them.
+class BetterCurveCacheInterner {
+public:
+	struct Key {
+		BetterCurve::SegmentsRef segments;
+		int resolution = 0;
+		real_t tolerance = 0.0;
+		BetterCurve::BakePrecision precision = BetterCurve::BAKE_PRECISION_FULL;
+		// Only part of the key for normalized tables, 0 otherwise.
+		real_t min_value = 0.0;
+		real_t max_value = 0.0;
+		bool inverse = false;
+		bool integral = false;
+
+		Key() {}
+		Key(const BetterCurve::SegmentsRef &p_segments, int p_resolution, real_t p_tolerance, BetterCurve::BakePrecision p_precision, real_t p_min, real_t p_max, bool p_inverse, bool p_integral);
+	};
+
+	static BetterCurveCacheInterner *get_singleton() { return singleton; }
+
+	// Table already baked for p_key, or nullptr.
+	BetterCurve::BakedCacheRef find(const Key &p_key);
+	// Returns the table interned for p_key if another curve got there first, p_cache otherwise.
+	BetterCurve::BakedCacheRef intern(const Key &p_key, const BetterCurve::BakedCacheRef &p_cache);
+
+	int get_entry_count();
+
+	BetterCurveCacheInterner();
+	~BetterCurveCacheInterner();
+
+private:
+	static BetterCurveCacheInterner *singleton;
+
+	struct Entry {
+		Key key;
+		std::weak_ptr<const BetterCurve::BakedCache> cache;
+	};
+
+	static uint32_t _hash(const Key &p_key);
+	static bool _matches(const Key &p_a, const Key &p_b);
+	// Must be called with _mutex held. Drops the entries whose table was released by every curve.
+	void _sweep();
+
+	// Guarded by _mutex.
+	HashMap<uint32_t, LocalVector<Entry>> _entries;
+	int _entry_count = 0;
+	int _insertions_since_sweep = 0;
+
+	std::mutex _mutex;
+};
+
+#endif // CURVATURE_CACHE_INTERNER_H
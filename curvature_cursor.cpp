@@ -0,0 +1,32 @@
+#include "curvature_cursor.h"
+
+void BetterCurveCursor::set_curve(const Ref<BetterCurve> &p_curve) {
+	curve = p_curve;
+	reset();
+}
+
+real_t BetterCurveCursor::sample(real_t p_offset) {
+	ERR_FAIL_COND_V(curve.is_null(), 0);
+
+	// The version is checked first, so the segments loaded are at least that recent.
+	uint32_t version = curve->get_segments_version();
+	if (version != segments_version || !cursor.segments) {
+		cursor.segments = curve->get_segments();
+		segments_version = version;
+	}
+	return cursor.sample(p_offset);
+}
+
+void BetterCurveCursor::reset() {
+	cursor.segments.reset();
+	cursor.index = 0;
+}
+
+void BetterCurveCursor::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_curve", "curve"), &BetterCurveCursor::set_curve);
+	ClassDB::bind_method(D_METHOD("get_curve"), &BetterCurveCursor::get_curve);
+	ClassDB::bind_method(D_METHOD("sample", "offset"), &BetterCurveCursor::sample);
+	ClassDB::bind_method(D_METHOD("reset"), &BetterCurveCursor::reset);
+
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "curve", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_curve", "get_curve");
+}
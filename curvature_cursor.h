@@ -0,0 +1,28 @@
+#ifndef CURVATURE_CURSOR_H
+#define CURVATURE_CURSOR_H
+
+#include "core/object/ref_counted.h"
+#include "curvature.h"
+
+// Samples a BetterCurve exactly, remembering where the previous sample landed.
+// Meant for offsets that move forward in small steps, like playback or timers.
+class BetterCurveCursor : public RefCounted {
+	GDCLASS(BetterCurveCursor, RefCounted);
+
+public:
+	void set_curve(const Ref<BetterCurve> &p_curve);
+	Ref<BetterCurve> get_curve() const { return curve; }
+
+	real_t sample(real_t p_offset);
+	void reset();
+
+protected:
+	static void _bind_methods();
+
+private:
+	Ref<BetterCurve> curve;
+	BetterCurve::Cursor cursor;
+	uint32_t segments_version = 0;
+};
+
+#endif // CURVATURE_CURSOR_H
@@ -0,0 +1,130 @@
+#include "curvature_evaluator.h"
+
+#include "core/object/worker_thread_pool.h"
+
+void BetterCurveEvaluator::set_curves(const TypedArray<BetterCurve> &p_curves) {
+	_curves.resize(p_curves.size());
+	for (int i = 0; i < p_curves.size(); ++i) {
+		_curves.write[i] = p_curves[i];
+	}
+}
+
+TypedArray<BetterCurve> BetterCurveEvaluator::get_curves() const {
+	TypedArray<BetterCurve> curves;
+	curves.resize(_curves.size());
+	for (int i = 0; i < _curves.size(); ++i) {
+		curves[i] = _curves[i];
+	}
+	return curves;
+}
+
+void BetterCurveEvaluator::set_stride(int p_stride) {
+	ERR_FAIL_COND(p_stride < 0);
+	_stride = p_stride;
+}
+
+void BetterCurveEvaluator::set_offset(int p_offset) {
+	ERR_FAIL_COND(p_offset < 0);
+	_offset = p_offset;
+}
+
+PackedFloat32Array BetterCurveEvaluator::evaluate(const PackedFloat32Array &p_offsets, const PackedFloat32Array &p_buffer) const {
+	PackedFloat32Array buffer = p_buffer;
+	const int count = p_offsets.size();
+	const int stride = _get_effective_stride();
+	ERR_FAIL_COND_V_MSG(_offset + _curves.size() > stride, buffer, "BetterCurveEvaluator offset and curve count don't fit in the stride.");
+	if (buffer.size() < count * stride) {
+		buffer.resize(count * stride);
+	}
+	evaluate_n(p_offsets.ptr(), count, buffer.ptrw());
+	return buffer;
+}
+
+void BetterCurveEvaluator::evaluate_n(const float *p_offsets, int p_count, float *r_buffer) const {
+	if (p_count <= 0 || _curves.is_empty()) {
+		return;
+	}
+	ERR_FAIL_NULL(p_offsets);
+	ERR_FAIL_NULL(r_buffer);
+	const int stride = _get_effective_stride();
+	ERR_FAIL_COND_MSG(_offset + _curves.size() > stride, "BetterCurveEvaluator offset and curve count don't fit in the stride.");
+
+	Job job;
+	job.caches.resize(_curves.size());
+	job.fallbacks.resize(_curves.size());
+	for (int k = 0; k < _curves.size(); ++k) {
+		const Ref<BetterCurve> &curve = _curves[k];
+		job.fallbacks[k] = 0;
+		if (curve.is_null()) {
+			continue;
+		}
+		BetterCurve::BakedCacheRef cache = curve->get_sampling_cache();
+		if (cache && cache->get_count() > 0) {
+			job.caches[k] = cache;
+		} else {
+			// Nothing baked yet, the curve samples as its first value like sample_baked() does.
+			BetterCurve::SegmentsRef segments = curve->get_segments();
+			job.fallbacks[k] = segments ? segments->first_y : 0.0;
+		}
+	}
+	job.offsets = p_offsets;
+	job.buffer = r_buffer;
+	job.count = p_count;
+	job.stride = stride;
+	job.offset = _offset;
+
+	const int task_count = (p_count + INSTANCES_PER_TASK - 1) / INSTANCES_PER_TASK;
+	if (task_count == 1) {
+		_evaluate_range(job, 0, p_count);
+		return;
+	}
+	WorkerThreadPool::GroupID group = WorkerThreadPool::get_singleton()->add_native_group_task(&BetterCurveEvaluator::_evaluate_task, &job, task_count, -1, true, "BetterCurveEvaluator");
+	WorkerThreadPool::get_singleton()->wait_for_group_task_completion(group);
+}
+
+void BetterCurveEvaluator::_evaluate_task(void *p_job, uint32_t p_task) {
+	const Job &job = *static_cast<const Job *>(p_job);
+	const int from = p_task * INSTANCES_PER_TASK;
+	_evaluate_range(job, from, MIN(from + INSTANCES_PER_TASK, job.count));
+}
+
+void BetterCurveEvaluator::_evaluate_range(const Job &p_job, int p_from, int p_to) {
+	// Curve by curve over small batches, so each table is sampled with sample_n() while it's hot.
+	const int BATCH_SIZE = 256;
+	real_t offsets[BATCH_SIZE];
+	real_t values[BATCH_SIZE];
+	for (int from = p_from; from < p_to; from += BATCH_SIZE) {
+		const int count = MIN(BATCH_SIZE, p_to - from);
+		for (int i = 0; i < count; ++i) {
+			offsets[i] = p_job.offsets[from + i];
+		}
+		for (uint32_t k = 0; k < p_job.caches.size(); ++k) {
+			const BetterCurve::BakedCacheRef &cache = p_job.caches[k];
+			if (cache) {
+				cache->sample_n(offsets, values, count);
+			} else {
+				for (int i = 0; i < count; ++i) {
+					values[i] = p_job.fallbacks[k];
+				}
+			}
+			float *dst = p_job.buffer + from * p_job.stride + p_job.offset + k;
+			for (int i = 0; i < count; ++i, dst += p_job.stride) {
+				*dst = values[i];
+			}
+		}
+	}
+}
+
+void BetterCurveEvaluator::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_curves", "curves"), &BetterCurveEvaluator::set_curves);
+	ClassDB::bind_method(D_METHOD("get_curves"), &BetterCurveEvaluator::get_curves);
+	ClassDB::bind_method(D_METHOD("set_stride", "stride"), &BetterCurveEvaluator::set_stride);
+	ClassDB::bind_method(D_METHOD("get_stride"), &BetterCurveEvaluator::get_stride);
+	ClassDB::bind_method(D_METHOD("set_offset", "offset"), &BetterCurveEvaluator::set_offset);
+	ClassDB::bind_method(D_METHOD("get_offset"), &BetterCurveEvaluator::get_offset);
+	ClassDB::bind_method(D_METHOD("evaluate", "offsets", "buffer"), &BetterCurveEvaluator::evaluate, DEFVAL(PackedFloat32Array()));
+
+	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "curves", PROPERTY_HINT_ARRAY_TYPE, MAKE_RESOURCE_TYPE_HINT("BetterCurve")), "set_curves", "get_curves");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "stride", PROPERTY_HINT_RANGE, "0,64,1,or_greater"), "set_stride", "get_stride");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "offset", PROPERTY_HINT_RANGE, "0,64,1,or_greater"), "set_offset", "get_offset");
+}
@@ -0,0 +1,55 @@
+#ifndef CURVATURE_EVALUATOR_H
+#define CURVATURE_EVALUATOR_H
+
+#include "core/object/ref_counted.h"
+#include "core/variant/typed_array.h"
+#include "curvature.h"
+
+// Samples several BetterCurves at many offsets in one call, on the WorkerThreadPool.
+// Instance i's value of curve k goes to buffer[i * stride + offset + k], so the buffer can be a MultiMesh buffer.
+class BetterCurveEvaluator : public RefCounted {
+	GDCLASS(BetterCurveEvaluator, RefCounted);
+
+public:
+	// Instances per thread pool task, fewer than this are evaluated on the calling thread.
+	static const int INSTANCES_PER_TASK = 1024;
+
+	void set_curves(const TypedArray<BetterCurve> &p_curves);
+	TypedArray<BetterCurve> get_curves() const;
+
+	// Floats per instance in the buffer, 0 for as many as there are curves.
+	void set_stride(int p_stride);
+	int get_stride() const { return _stride; }
+	void set_offset(int p_offset);
+	int get_offset() const { return _offset; }
+
+	// Returns p_buffer with the values written, grown if it's too small for p_offsets. The other floats are kept.
+	PackedFloat32Array evaluate(const PackedFloat32Array &p_offsets, const PackedFloat32Array &p_buffer = PackedFloat32Array()) const;
+	// Same, into memory of at least p_count * stride floats.
+	void evaluate_n(const float *p_offsets, int p_count, float *r_buffer) const;
+
+protected:
+	static void _bind_methods();
+
+private:
+	struct Job {
+		// One snapshot per curve for the whole call, null where there's no table to sample.
+		LocalVector<BetterCurve::BakedCacheRef> caches;
+		LocalVector<real_t> fallbacks;
+		const float *offsets = nullptr;
+		float *buffer = nullptr;
+		int count = 0;
+		int stride = 0;
+		int offset = 0;
+	};
+	static void _evaluate_task(void *p_job, uint32_t p_task);
+	static void _evaluate_range(const Job &p_job, int p_from, int p_to);
+
+	int _get_effective_stride() const { return _stride > 0 ? _stride : _curves.size(); }
+
+	Vector<Ref<BetterCurve>> _curves;
+	int _stride = 0;
+	int _offset = 0;
+};
+
+#endif // CURVATURE_EVALUATOR_H
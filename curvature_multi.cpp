@@ -0,0 +1,162 @@
+#include "curvature_multi.h"
+
+Vector4 BetterCurveN::BakedCache::sample(real_t p_offset) const {
+	const int size = get_sample_count();
+	if (size == 0) {
+		return Vector4();
+	}
+	const real_t *v = values.ptr();
+	if (size == 1) {
+		return Vector4(v[0], v[1], v[2], v[3]);
+	}
+
+	// Same interpolation as BetterCurve::BakedCache::sample(), on every channel at once.
+	// Clamped before the index cast, which is undefined for NaN and out of range values.
+	const real_t offset = p_offset >= BetterCurve::MIN_X ? MIN(p_offset, (real_t)BetterCurve::MAX_X) : (real_t)BetterCurve::MIN_X;
+	real_t fi = (offset - BetterCurve::MIN_X) * (size - 1);
+	int i = Math::floor(fi);
+	if (i < 0) {
+		i = 0;
+		fi = 0;
+	} else if (i >= size - 1) {
+		const real_t *last = v + (size - 1) * CHANNEL_COUNT;
+		return Vector4(last[0], last[1], last[2], last[3]);
+	}
+
+	const real_t t = fi - i;
+	const real_t *a = v + i * CHANNEL_COUNT;
+	const real_t *b = a + CHANNEL_COUNT;
+	return Vector4(
+			Math::lerp(a[0], b[0], t),
+			Math::lerp(a[1], b[1], t),
+			Math::lerp(a[2], b[2], t),
+			Math::lerp(a[3], b[3], t));
+}
+
+void BetterCurveN::set_channel(int p_channel, const Ref<BetterCurve> &p_curve) {
+	ERR_FAIL_INDEX(p_channel, CHANNEL_COUNT);
+	Ref<BetterCurve> &channel = _channels[p_channel];
+	if (channel == p_curve) {
+		return;
+	}
+
+	// The same curve may be used by several channels, it's only connected once.
+	if (channel.is_valid() && !_is_used_by_other_channel(channel, p_channel)) {
+		channel->disconnect_changed(callable_mp(this, &BetterCurveN::_channel_changed));
+	}
+	channel = p_curve;
+	if (channel.is_valid() && !_is_used_by_other_channel(channel, p_channel)) {
+		channel->connect_changed(callable_mp(this, &BetterCurveN::_channel_changed));
+	}
+	_channel_changed();
+}
+
+bool BetterCurveN::_is_used_by_other_channel(const Ref<BetterCurve> &p_curve, int p_channel) const {
+	for (int i = 0; i < CHANNEL_COUNT; ++i) {
+		if (i != p_channel && _channels[i] == p_curve) {
+			return true;
+		}
+	}
+	return false;
+}
+
+Ref<BetterCurve> BetterCurveN::get_channel(int p_channel) const {
+	ERR_FAIL_INDEX_V(p_channel, CHANNEL_COUNT, Ref<BetterCurve>());
+	return _channels[p_channel];
+}
+
+void BetterCurveN::set_bake_resolution(int p_resolution) {
+	ERR_FAIL_COND(p_resolution < 1);
+	ERR_FAIL_COND(p_resolution > 1000);
+	if (_bake_resolution == p_resolution) {
+		return;
+	}
+	_bake_resolution = p_resolution;
+	_channel_changed();
+}
+
+void BetterCurveN::_channel_changed() {
+	// Channels rebuild their segments before notifying, the table is re-baked from them on the next read.
+	_baked_cache_dirty.store(true, std::memory_order_release);
+	emit_changed();
+}
+
+BetterCurveN::BakedCacheRef BetterCurveN::get_baked_cache() const {
+	if (_baked_cache_dirty.load(std::memory_order_acquire)) {
+		std::lock_guard<std::mutex> lock(_bake_mutex);
+		// Another reader may have re-baked while this one was waiting.
+		if (_baked_cache_dirty.load(std::memory_order_acquire)) {
+			// Cleared before reading the segments, so an edit made during the bake dirties the table again.
+			_baked_cache_dirty.store(false, std::memory_order_release);
+			std::atomic_store_explicit(&_baked_cache, _bake(), std::memory_order_release);
+		}
+	}
+	BakedCacheRef cache = std::atomic_load_explicit(&_baked_cache, std::memory_order_acquire);
+	if (!cache) {
+		// The very first bake is still running on another thread, it holds the lock until it's published.
+		std::lock_guard<std::mutex> lock(_bake_mutex);
+		cache = std::atomic_load_explicit(&_baked_cache, std::memory_order_acquire);
+	}
+	return cache;
+}
+
+BetterCurveN::BakedCacheRef BetterCurveN::_bake() const {
+	std::shared_ptr<BakedCache> cache = std::make_shared<BakedCache>();
+	const int resolution = _bake_resolution;
+	cache->values.resize(resolution * CHANNEL_COUNT);
+	real_t *w = cache->values.ptrw();
+
+	for (int c = 0; c < CHANNEL_COUNT; ++c) {
+		// Offsets only grow, so a cursor finds every segment in amortized O(1).
+		BetterCurve::Cursor cursor;
+		if (_channels[c].is_valid()) {
+			cursor.segments = _channels[c]->get_segments();
+		}
+		for (int i = 0; i < resolution; ++i) {
+			const real_t x = resolution > 1 ? BetterCurve::MIN_X + (BetterCurve::MAX_X - BetterCurve::MIN_X) * i / static_cast<real_t>(resolution - 1) : BetterCurve::MIN_X;
+			w[i * CHANNEL_COUNT + c] = cursor.sample(x);
+		}
+	}
+	return cache;
+}
+
+Vector4 BetterCurveN::sample(real_t p_offset) const {
+	BakedCacheRef cache = get_baked_cache();
+	return cache->sample(p_offset);
+}
+
+Color BetterCurveN::sample_color(real_t p_offset) const {
+	const Vector4 v = sample(p_offset);
+	return Color(v.x, v.y, v.z, v.w);
+}
+
+void BetterCurveN::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_channel", "channel", "curve"), &BetterCurveN::set_channel);
+	ClassDB::bind_method(D_METHOD("get_channel", "channel"), &BetterCurveN::get_channel);
+	ClassDB::bind_method(D_METHOD("set_bake_resolution", "resolution"), &BetterCurveN::set_bake_resolution);
+	ClassDB::bind_method(D_METHOD("get_bake_resolution"), &BetterCurveN::get_bake_resolution);
+	ClassDB::bind_method(D_METHOD("sample", "offset"), &BetterCurveN::sample);
+	ClassDB::bind_method(D_METHOD("sample_color", "offset"), &BetterCurveN::sample_color);
+
+	ADD_PROPERTYI(PropertyInfo(Variant::OBJECT, "curve_x", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_channel", "get_channel", 0);
+	ADD_PROPERTYI(PropertyInfo(Variant::OBJECT, "curve_y", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_channel", "get_channel", 1);
+	ADD_PROPERTYI(PropertyInfo(Variant::OBJECT, "curve_z", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_channel", "get_channel", 2);
+	ADD_PROPERTYI(PropertyInfo(Variant::OBJECT, "curve_w", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_channel", "get_channel", 3);
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "bake_resolution", PROPERTY_HINT_RANGE, "1,1000,1"), "set_bake_resolution", "get_bake_resolution");
+}
+
+BetterCurveN::BetterCurveN() {
+}
+
+BetterCurveN::~BetterCurveN() {
+	for (int i = 0; i < CHANNEL_COUNT; ++i) {
+		// Only the first channel holding a curve disconnects it.
+		bool first = true;
+		for (int j = 0; j < i; ++j) {
+			first &= _channels[j] != _channels[i];
+		}
+		if (_channels[i].is_valid() && first) {
+			_channels[i]->disconnect_changed(callable_mp(this, &BetterCurveN::_channel_changed));
+		}
+	}
+}
@@ -0,0 +1,60 @@
+#ifndef CURVATURE_MULTI_H
+#define CURVATURE_MULTI_H
+
+#include "core/io/resource.h"
+#include "curvature.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+// Up to CHANNEL_COUNT curves sampled at the same offset, like the channels of a color ramp.
+// They're baked into a single interleaved table, so one sample() reads all the channels from adjacent memory.
+class BetterCurveN : public Resource {
+	GDCLASS(BetterCurveN, Resource);
+
+public:
+	static const int CHANNEL_COUNT = 4;
+
+	// Immutable interleaved table, CHANNEL_COUNT values per sample. Rebuilt as a whole like BetterCurve::BakedCache.
+	struct BakedCache {
+		Vector<real_t> values;
+
+		int get_sample_count() const { return values.size() / CHANNEL_COUNT; }
+		Vector4 sample(real_t p_offset) const;
+	};
+	typedef std::shared_ptr<const BakedCache> BakedCacheRef;
+
+	void set_channel(int p_channel, const Ref<BetterCurve> &p_curve);
+	Ref<BetterCurve> get_channel(int p_channel) const;
+
+	int get_bake_resolution() const { return _bake_resolution; }
+	void set_bake_resolution(int p_resolution);
+
+	// Channels without a curve sample as 0.
+	Vector4 sample(real_t p_offset) const;
+	Color sample_color(real_t p_offset) const;
+
+	// Current snapshot, rebuilt first if one of the channels changed since.
+	BakedCacheRef get_baked_cache() const;
+
+	BetterCurveN();
+	~BetterCurveN();
+
+protected:
+	static void _bind_methods();
+
+private:
+	void _channel_changed();
+	bool _is_used_by_other_channel(const Ref<BetterCurve> &p_curve, int p_channel) const;
+	BakedCacheRef _bake() const;
+
+	Ref<BetterCurve> _channels[CHANNEL_COUNT];
+	int _bake_resolution = 100;
+
+	mutable BakedCacheRef _baked_cache; // Only accessed through the std::atomic_* free functions.
+	mutable std::atomic<bool> _baked_cache_dirty{ true };
+	mutable std::mutex _bake_mutex;
+};
+
+#endif // CURVATURE_MULTI_H
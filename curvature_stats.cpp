@@ -0,0 +1,86 @@
+#include "curvature_stats.h"
+
+#include "core/object/callable_method_pointer.h"
+#include "core/os/os.h"
+#include "main/performance.h"
+
+std::atomic<uint64_t> BetterCurveStats::_bake_count{ 0 };
+std::atomic<uint64_t> BetterCurveStats::_bake_usec{ 0 };
+std::atomic<int64_t> BetterCurveStats::_live_curves{ 0 };
+
+// Only touched by the monitors, which are all polled from the main thread.
+static uint64_t window_start_usec = 0;
+static uint64_t window_start_count = 0;
+static uint64_t window_start_bake_usec = 0;
+static double bakes_per_sec = 0.0;
+static double bake_ms = 0.0;
+
+void BetterCurveStats::_update_window() {
+	const uint64_t now = OS::get_singleton()->get_ticks_usec();
+	if (window_start_usec == 0) {
+		window_start_usec = now;
+		window_start_count = get_bake_count();
+		window_start_bake_usec = get_bake_usec();
+		return;
+	}
+	const uint64_t elapsed = now - window_start_usec;
+	if (elapsed < WINDOW_USEC) {
+		return;
+	}
+
+	const uint64_t count = get_bake_count();
+	const uint64_t usec = get_bake_usec();
+	const uint64_t bakes = count - window_start_count;
+	bakes_per_sec = bakes * 1000000.0 / elapsed;
+	// The average of the bakes done in the window, so a single slow bake doesn't linger.
+	bake_ms = bakes > 0 ? (usec - window_start_bake_usec) / (bakes * 1000.0) : 0.0;
+
+	window_start_usec = now;
+	window_start_count = count;
+	window_start_bake_usec = usec;
+}
+
+double BetterCurveStats::_get_bakes_per_sec() {
+	_update_window();
+	return bakes_per_sec;
+}
+
+double BetterCurveStats::_get_bake_ms() {
+	_update_window();
+	return bake_ms;
+}
+
+int64_t BetterCurveStats::_get_live_curves() {
+	return get_live_curves();
+}
+
+void BetterCurveStats::add_monitors() {
+	Performance *performance = Performance::get_singleton();
+	if (performance == nullptr) {
+		// Modules are initialized before Performance exists, it does by the time deferred calls run.
+		callable_mp_static(&BetterCurveStats::add_monitors).call_deferred();
+		return;
+	}
+	if (!performance->has_custom_monitor(MONITOR_BAKES_PER_SEC)) {
+		performance->add_custom_monitor(MONITOR_BAKES_PER_SEC, callable_mp_static(&BetterCurveStats::_get_bakes_per_sec), Vector<Variant>());
+	}
+	if (!performance->has_custom_monitor(MONITOR_BAKE_MS)) {
+		performance->add_custom_monitor(MONITOR_BAKE_MS, callable_mp_static(&BetterCurveStats::_get_bake_ms), Vector<Variant>());
+	}
+	if (!performance->has_custom_monitor(MONITOR_LIVE_CURVES)) {
+		performance->add_custom_monitor(MONITOR_LIVE_CURVES, callable_mp_static(&BetterCurveStats::_get_live_curves), Vector<Variant>());
+	}
+}
+
+void BetterCurveStats::remove_monitors() {
+	Performance *performance = Performance::get_singleton();
+	if (performance == nullptr) {
+		return;
+	}
+	const char *ids[] = { MONITOR_BAKES_PER_SEC, MONITOR_BAKE_MS, MONITOR_LIVE_CURVES };
+	for (const char *id : ids) {
+		if (performance->has_custom_monitor(id)) {
+			performance->remove_custom_monitor(id);
+		}
+	}
+}
@@ -0,0 +1,42 @@
+#ifndef CURVATURE_STATS_H
+#define CURVATURE_STATS_H
+
+#include <atomic>
+#include <cstdint>
+
+// Module-wide bake counters, summed over every BetterCurve and shown as Performance custom monitors.
+// Static, so curves baking outside of the module's lifetime don't need to check for an instance.
+class BetterCurveStats {
+public:
+	static constexpr const char *MONITOR_BAKES_PER_SEC = "curvature/bakes_per_sec";
+	static constexpr const char *MONITOR_BAKE_MS = "curvature/bake_ms";
+	static constexpr const char *MONITOR_LIVE_CURVES = "curvature/live_curves";
+
+	static void record_bake(uint64_t p_usec) {
+		_bake_count.fetch_add(1, std::memory_order_relaxed);
+		_bake_usec.fetch_add(p_usec, std::memory_order_relaxed);
+	}
+	static void curve_created() { _live_curves.fetch_add(1, std::memory_order_relaxed); }
+	static void curve_destroyed() { _live_curves.fetch_sub(1, std::memory_order_relaxed); }
+
+	static uint64_t get_bake_count() { return _bake_count.load(std::memory_order_relaxed); }
+	static uint64_t get_bake_usec() { return _bake_usec.load(std::memory_order_relaxed); }
+	static int64_t get_live_curves() { return _live_curves.load(std::memory_order_relaxed); }
+
+	static void add_monitors();
+	static void remove_monitors();
+
+private:
+	static std::atomic<uint64_t> _bake_count;
+	static std::atomic<uint64_t> _bake_usec;
+	static std::atomic<int64_t> _live_curves;
+
+	// Rates are measured over windows of at least this long, the monitors are polled every frame.
+	static constexpr uint64_t WINDOW_USEC = 1000000;
+	static void _update_window();
+	static double _get_bakes_per_sec();
+	static double _get_bake_ms();
+	static int64_t _get_live_curves();
+};
+
+#endif // CURVATURE_STATS_H
@@ -0,0 +1,292 @@
+#include "curvature_texture.h"
+
+#include "core/templates/local_vector.h"
+#include "servers/rendering_server.h"
+
+uint32_t BetterCurveTexture::fill_row(const Ref<BetterCurve> &p_curve, int p_width, Precision p_precision, uint8_t *p_dst) {
+	if (p_curve.is_null()) {
+		// Zero bits are 0.0 in both layouts.
+		memset(p_dst, 0, p_width * get_texel_size(p_precision));
+		return 0;
+	}
+
+	// Loaded before the snapshot, so the generation is never newer than what's written.
+	const uint32_t generation = p_curve->get_bake_generation();
+	// One snapshot for the whole row.
+	BetterCurve::BakedCacheRef cache = p_curve->get_sampling_cache();
+
+	// A uniform table of the texture's width has its values at the texels' offsets already.
+	if (cache && !cache->is_adaptive() && p_width > 1 && cache->get_count() == p_width) {
+		if (p_precision == PRECISION_FULL && cache->precision == BetterCurve::BAKE_PRECISION_FULL) {
+#ifdef REAL_T_IS_DOUBLE
+			float *dst = reinterpret_cast<float *>(p_dst);
+			const real_t *src = cache->values.ptr();
+			for (int i = 0; i < p_width; ++i) {
+				dst[i] = src[i];
+			}
+#else
+			memcpy(p_dst, cache->values.ptr(), p_width * sizeof(float));
+#endif
+			return generation;
+		}
+		if (p_precision == PRECISION_HALF && cache->precision == BetterCurve::BAKE_PRECISION_HALF) {
+			memcpy(p_dst, cache->quantized.ptr(), p_width * sizeof(uint16_t));
+			return generation;
+		}
+	}
+
+	LocalVector<real_t> offsets;
+	LocalVector<real_t> values;
+	offsets.resize(p_width);
+	values.resize(p_width);
+	for (int i = 0; i < p_width; ++i) {
+		offsets[i] = p_width > 1 ? i / static_cast<real_t>(p_width - 1) : 0.0;
+	}
+	if (cache && cache->get_count() > 0) {
+		cache->sample_n(offsets.ptr(), values.ptr(), p_width);
+	} else {
+		// Nothing baked yet, the curve has its own fallback for that.
+		p_curve->sample_n(offsets.ptr(), values.ptr(), p_width);
+	}
+
+	if (p_precision == PRECISION_HALF) {
+		uint16_t *dst = reinterpret_cast<uint16_t *>(p_dst);
+		for (int i = 0; i < p_width; ++i) {
+			dst[i] = Math::make_half_float(values[i]);
+		}
+	} else {
+		float *dst = reinterpret_cast<float *>(p_dst);
+		for (int i = 0; i < p_width; ++i) {
+			dst[i] = values[i];
+		}
+	}
+	return generation;
+}
+
+void BetterCurveTexture::set_curve(const Ref<BetterCurve> &p_curve) {
+	if (_curve == p_curve) {
+		return;
+	}
+	if (_curve.is_valid()) {
+		_curve->disconnect(BetterCurve::SIGNAL_BAKED, callable_mp(this, &BetterCurveTexture::_update));
+	}
+	_curve = p_curve;
+	_current_generation = -1;
+	if (_curve.is_valid()) {
+		// Deferred, so that synchronous bakes never upload in the middle of an edit.
+		_curve->connect(BetterCurve::SIGNAL_BAKED, callable_mp(this, &BetterCurveTexture::_update), CONNECT_DEFERRED);
+	}
+	_update();
+}
+
+void BetterCurveTexture::set_width(int p_width) {
+	ERR_FAIL_COND(p_width < 1 || p_width > 16384);
+	_width = p_width;
+	_update();
+}
+
+void BetterCurveTexture::set_precision(Precision p_precision) {
+	ERR_FAIL_INDEX(p_precision, 2);
+	_precision = p_precision;
+	_update();
+}
+
+void BetterCurveTexture::_update() {
+	const bool reshaped = !_texture.is_valid() || _current_width != _width || _current_precision != _precision;
+	// Bakes that didn't publish a new table, like one joining an interned table it already had, change nothing.
+	if (!reshaped && _curve.is_valid() && _curve->get_bake_generation() == _current_generation) {
+		return;
+	}
+
+	Vector<uint8_t> data;
+	data.resize(_width * get_texel_size(_precision));
+	const uint32_t generation = fill_row(_curve, _width, _precision, data.ptrw());
+	_current_generation = _curve.is_valid() ? generation : -1;
+
+	Ref<Image> image = memnew(Image(_width, 1, false, get_image_format(_precision), data));
+
+	if (!_texture.is_valid()) {
+		_texture = RS::get_singleton()->texture_2d_create(image);
+	} else if (reshaped) {
+		RID new_texture = RS::get_singleton()->texture_2d_create(image);
+		RS::get_singleton()->texture_replace(_texture, new_texture);
+	} else {
+		// Same size and format, so the texture is updated in place and users don't need to know.
+		RS::get_singleton()->texture_2d_update(_texture, image);
+	}
+	_current_width = _width;
+	_current_precision = _precision;
+
+	if (reshaped) {
+		emit_changed();
+	}
+}
+
+RID BetterCurveTexture::get_rid() const {
+	if (!_texture.is_valid()) {
+		_texture = RS::get_singleton()->texture_2d_placeholder_create();
+	}
+	return _texture;
+}
+
+void BetterCurveTexture::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_curve", "curve"), &BetterCurveTexture::set_curve);
+	ClassDB::bind_method(D_METHOD("get_curve"), &BetterCurveTexture::get_curve);
+	ClassDB::bind_method(D_METHOD("set_width", "width"), &BetterCurveTexture::set_width);
+	ClassDB::bind_method(D_METHOD("set_precision", "precision"), &BetterCurveTexture::set_precision);
+	ClassDB::bind_method(D_METHOD("get_precision"), &BetterCurveTexture::get_precision);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "width", PROPERTY_HINT_RANGE, "1,4096,1,or_greater,suffix:px"), "set_width", "get_width");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "precision", PROPERTY_HINT_ENUM, "Full (R32F),Half (R16F)"), "set_precision", "get_precision");
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "curve", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_curve", "get_curve");
+
+	BIND_ENUM_CONSTANT(PRECISION_FULL);
+	BIND_ENUM_CONSTANT(PRECISION_HALF);
+}
+
+BetterCurveTexture::BetterCurveTexture() {
+}
+
+BetterCurveTexture::~BetterCurveTexture() {
+	if (_texture.is_valid()) {
+		ERR_FAIL_NULL(RenderingServer::get_singleton());
+		RS::get_singleton()->free(_texture);
+	}
+}
+
+///////////////////////
+
+void BetterCurveAtlasTexture::set_curves(const TypedArray<BetterCurve> &p_curves) {
+	_disconnect_curves();
+	_curves.resize(p_curves.size());
+	_row_generations.resize(p_curves.size());
+	for (int i = 0; i < p_curves.size(); ++i) {
+		_curves.write[i] = p_curves[i];
+		_row_generations.write[i] = -1;
+	}
+	_connect_curves();
+	_update();
+}
+
+TypedArray<BetterCurve> BetterCurveAtlasTexture::get_curves() const {
+	TypedArray<BetterCurve> curves;
+	curves.resize(_curves.size());
+	for (int i = 0; i < _curves.size(); ++i) {
+		curves[i] = _curves[i];
+	}
+	return curves;
+}
+
+void BetterCurveAtlasTexture::_connect_curves() {
+	for (const Ref<BetterCurve> &curve : _curves) {
+		// A curve may be in several rows, it still only needs one connection.
+		if (curve.is_null() || curve->is_connected(BetterCurve::SIGNAL_BAKED, callable_mp(this, &BetterCurveAtlasTexture::_curve_baked))) {
+			continue;
+		}
+		// The id rather than a reference is bound, so the connection doesn't keep the curve alive.
+		curve->connect(BetterCurve::SIGNAL_BAKED, callable_mp(this, &BetterCurveAtlasTexture::_curve_baked).bind(curve->get_instance_id()), CONNECT_DEFERRED);
+	}
+}
+
+void BetterCurveAtlasTexture::_disconnect_curves() {
+	for (const Ref<BetterCurve> &curve : _curves) {
+		if (curve.is_valid() && curve->is_connected(BetterCurve::SIGNAL_BAKED, callable_mp(this, &BetterCurveAtlasTexture::_curve_baked))) {
+			curve->disconnect(BetterCurve::SIGNAL_BAKED, callable_mp(this, &BetterCurveAtlasTexture::_curve_baked));
+		}
+	}
+}
+
+void BetterCurveAtlasTexture::set_width(int p_width) {
+	ERR_FAIL_COND(p_width < 1 || p_width > 16384);
+	_width = p_width;
+	_update();
+}
+
+void BetterCurveAtlasTexture::set_precision(BetterCurveTexture::Precision p_precision) {
+	ERR_FAIL_INDEX(p_precision, 2);
+	_precision = p_precision;
+	_update();
+}
+
+void BetterCurveAtlasTexture::_curve_baked(ObjectID p_curve_id) {
+	_update(p_curve_id);
+}
+
+void BetterCurveAtlasTexture::_update(ObjectID p_curve_id) {
+	const int height = get_height();
+	const int row_size = _width * BetterCurveTexture::get_texel_size(_precision);
+	const bool reshaped = !_texture.is_valid() || _current_width != _width || _current_height != height || _current_precision != _precision;
+
+	if (_data.size() != height * row_size) {
+		_data.resize(height * row_size);
+		memset(_data.ptrw(), 0, _data.size());
+	}
+
+	uint8_t *w = _data.ptrw();
+	int64_t *generations = _row_generations.ptrw();
+	bool changed = reshaped;
+	for (int row = 0; row < _curves.size(); ++row) {
+		const Ref<BetterCurve> &curve = _curves[row];
+		if (!reshaped && p_curve_id.is_valid() && (curve.is_null() || curve->get_instance_id() != p_curve_id)) {
+			continue;
+		}
+		// Rows whose curve published nothing new since they were filled are kept as they are.
+		if (!reshaped && curve.is_valid() && curve->get_bake_generation() == generations[row]) {
+			continue;
+		}
+		const uint32_t generation = BetterCurveTexture::fill_row(curve, _width, _precision, w + row * row_size);
+		generations[row] = curve.is_valid() ? generation : -1;
+		changed = true;
+	}
+	if (!changed) {
+		return;
+	}
+
+	// RenderingServer has no sub-rectangle update, but same-sized uploads keep the texture in place.
+	Ref<Image> image = memnew(Image(_width, height, false, BetterCurveTexture::get_image_format(_precision), _data));
+	if (!_texture.is_valid()) {
+		_texture = RS::get_singleton()->texture_2d_create(image);
+	} else if (reshaped) {
+		RID new_texture = RS::get_singleton()->texture_2d_create(image);
+		RS::get_singleton()->texture_replace(_texture, new_texture);
+	} else {
+		RS::get_singleton()->texture_2d_update(_texture, image);
+	}
+	_current_width = _width;
+	_current_height = height;
+	_current_precision = _precision;
+
+	if (reshaped) {
+		emit_changed();
+	}
+}
+
+RID BetterCurveAtlasTexture::get_rid() const {
+	if (!_texture.is_valid()) {
+		_texture = RS::get_singleton()->texture_2d_placeholder_create();
+	}
+	return _texture;
+}
+
+void BetterCurveAtlasTexture::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_curves", "curves"), &BetterCurveAtlasTexture::set_curves);
+	ClassDB::bind_method(D_METHOD("get_curves"), &BetterCurveAtlasTexture::get_curves);
+	ClassDB::bind_method(D_METHOD("set_width", "width"), &BetterCurveAtlasTexture::set_width);
+	ClassDB::bind_method(D_METHOD("set_precision", "precision"), &BetterCurveAtlasTexture::set_precision);
+	ClassDB::bind_method(D_METHOD("get_precision"), &BetterCurveAtlasTexture::get_precision);
+
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "width", PROPERTY_HINT_RANGE, "1,4096,1,or_greater,suffix:px"), "set_width", "get_width");
+	ADD_PROPERTY(PropertyInfo(Variant::INT, "precision", PROPERTY_HINT_ENUM, "Full (R32F),Half (R16F)"), "set_precision", "get_precision");
+	ADD_PROPERTY(PropertyInfo(Variant::ARRAY, "curves", PROPERTY_HINT_ARRAY_TYPE, MAKE_RESOURCE_TYPE_HINT("BetterCurve")), "set_curves", "get_curves");
+}
+
+BetterCurveAtlasTexture::BetterCurveAtlasTexture() {
+}
+
+BetterCurveAtlasTexture::~BetterCurveAtlasTexture() {
+	_disconnect_curves();
+	if (_texture.is_valid()) {
+		ERR_FAIL_NULL(RenderingServer::get_singleton());
+		RS::get_singleton()->free(_texture);
+	}
+}
@@ -0,0 +1,100 @@
+#ifndef CURVATURE_TEXTURE_H
+#define CURVATURE_TEXTURE_H
+
+#include "core/io/image.h"
+#include "curvature.h"
+#include "scene/resources/texture.h"
+
+// 1D float texture of a BetterCurve, re-uploaded every time a bake publishes a new table.
+class BetterCurveTexture : public Texture2D {
+	GDCLASS(BetterCurveTexture, Texture2D);
+
+public:
+	enum Precision {
+		PRECISION_FULL = 0, // R32F
+		PRECISION_HALF, // R16F
+	};
+
+	void set_curve(const Ref<BetterCurve> &p_curve);
+	Ref<BetterCurve> get_curve() const { return _curve; }
+
+	void set_width(int p_width);
+	virtual int get_width() const override { return _width; }
+	virtual int get_height() const override { return 1; }
+
+	void set_precision(Precision p_precision);
+	Precision get_precision() const { return _precision; }
+
+	virtual RID get_rid() const override;
+	virtual bool has_alpha() const override { return false; }
+
+	// Writes p_curve at p_width uniform offsets into p_dst, in the layout of p_precision, and returns the
+	// bake generation the row is at least as recent as. A table of that size and layout is copied rather than resampled.
+	static uint32_t fill_row(const Ref<BetterCurve> &p_curve, int p_width, Precision p_precision, uint8_t *p_dst);
+	static int get_texel_size(Precision p_precision) { return p_precision == PRECISION_HALF ? 2 : 4; }
+	static Image::Format get_image_format(Precision p_precision) { return p_precision == PRECISION_HALF ? Image::FORMAT_RH : Image::FORMAT_RF; }
+
+	BetterCurveTexture();
+	~BetterCurveTexture();
+
+protected:
+	static void _bind_methods();
+
+private:
+	void _update();
+
+	mutable RID _texture;
+	Ref<BetterCurve> _curve;
+	int _width = 256;
+	Precision _precision = PRECISION_FULL;
+	int _current_width = 0;
+	Precision _current_precision = PRECISION_FULL;
+	int64_t _current_generation = -1; // Bake generation of the uploaded row, -1 to upload regardless.
+};
+
+// Several BetterCurves packed into one texture, a row per curve, so a material can read all of them from a single sampler.
+// Row i is sampled at UV (offset, (i + 0.5) / curve count).
+class BetterCurveAtlasTexture : public Texture2D {
+	GDCLASS(BetterCurveAtlasTexture, Texture2D);
+
+public:
+	void set_curves(const TypedArray<BetterCurve> &p_curves);
+	TypedArray<BetterCurve> get_curves() const;
+
+	void set_width(int p_width);
+	virtual int get_width() const override { return _width; }
+	virtual int get_height() const override { return MAX(_curves.size(), 1); }
+
+	void set_precision(BetterCurveTexture::Precision p_precision);
+	BetterCurveTexture::Precision get_precision() const { return _precision; }
+
+	virtual RID get_rid() const override;
+	virtual bool has_alpha() const override { return false; }
+
+	BetterCurveAtlasTexture();
+	~BetterCurveAtlasTexture();
+
+protected:
+	static void _bind_methods();
+
+private:
+	void _connect_curves();
+	void _disconnect_curves();
+	void _curve_baked(ObjectID p_curve_id);
+	// Refills every row, or only the rows of p_curve_id when it's valid, then uploads the image if a row changed.
+	void _update(ObjectID p_curve_id = ObjectID());
+
+	mutable RID _texture;
+	Vector<Ref<BetterCurve>> _curves;
+	Vector<uint8_t> _data; // CPU copy of the texture, so a bake only resamples its own rows.
+	Vector<int64_t> _row_generations; // Bake generation of each row in _data, -1 to refill regardless.
+	int _width = 256;
+	BetterCurveTexture::Precision _precision = BetterCurveTexture::PRECISION_FULL;
+	int _current_width = 0;
+	int _current_height = 0;
+	BetterCurveTexture::Precision _current_precision = BetterCurveTexture::PRECISION_FULL;
+};
+
+VARIANT_ENUM_CAST(BetterCurveTexture::Precision)
+
+#endif // CURVATURE_TEXTURE_H
@@ -0,0 +1,82 @@
+#include "curvature_visual_shader.h"
+
+String VisualShaderNodeBetterCurve::get_caption() const {
+	return "BetterCurve";
+}
+
+int VisualShaderNodeBetterCurve::get_input_port_count() const {
+	return 1;
+}
+
+VisualShaderNode::PortType VisualShaderNodeBetterCurve::get_input_port_type(int p_port) const {
+	return PORT_TYPE_SCALAR;
+}
+
+String VisualShaderNodeBetterCurve::get_input_port_name(int p_port) const {
+	return "offset";
+}
+
+int VisualShaderNodeBetterCurve::get_output_port_count() const {
+	return 1;
+}
+
+VisualShaderNode::PortType VisualShaderNodeBetterCurve::get_output_port_type(int p_port) const {
+	return PORT_TYPE_SCALAR;
+}
+
+String VisualShaderNodeBetterCurve::get_output_port_name(int p_port) const {
+	return "value";
+}
+
+String VisualShaderNodeBetterCurve::_get_function_name(VisualShader::Type p_type, int p_id) {
+	return vformat("better_curve_%d_%d", p_type, p_id);
+}
+
+String VisualShaderNodeBetterCurve::generate_global(Shader::Mode p_mode, VisualShader::Type p_type, int p_id) const {
+	const String name = _get_function_name(p_type, p_id);
+	if (_curve.is_null()) {
+		return "float " + name + "(float x) {\n\treturn 0.0;\n}\n";
+	}
+	return _curve->to_shader_function(name);
+}
+
+String VisualShaderNodeBetterCurve::generate_code(Shader::Mode p_mode, VisualShader::Type p_type, int p_id, const String *p_input_vars, const String *p_output_vars, bool p_for_preview) const {
+	return "\t" + p_output_vars[0] + " = " + _get_function_name(p_type, p_id) + "(" + p_input_vars[0] + ");\n";
+}
+
+Vector<StringName> VisualShaderNodeBetterCurve::get_editable_properties() const {
+	Vector<StringName> props;
+	props.push_back("curve");
+	return props;
+}
+
+void VisualShaderNodeBetterCurve::set_curve(const Ref<BetterCurve> &p_curve) {
+	if (_curve == p_curve) {
+		return;
+	}
+	if (_curve.is_valid()) {
+		_curve->disconnect_changed(callable_mp(this, &VisualShaderNodeBetterCurve::_curve_changed));
+	}
+	_curve = p_curve;
+	if (_curve.is_valid()) {
+		// The segments are already rebuilt when the curve notifies, no need to wait for its bake.
+		_curve->connect_changed(callable_mp(this, &VisualShaderNodeBetterCurve::_curve_changed));
+	}
+	emit_changed();
+}
+
+void VisualShaderNodeBetterCurve::_curve_changed() {
+	// The owning VisualShader regenerates its code whenever one of its nodes changes.
+	emit_changed();
+}
+
+void VisualShaderNodeBetterCurve::_bind_methods() {
+	ClassDB::bind_method(D_METHOD("set_curve", "curve"), &VisualShaderNodeBetterCurve::set_curve);
+	ClassDB::bind_method(D_METHOD("get_curve"), &VisualShaderNodeBetterCurve::get_curve);
+
+	ADD_PROPERTY(PropertyInfo(Variant::OBJECT, "curve", PROPERTY_HINT_RESOURCE_TYPE, "BetterCurve"), "set_curve", "get_curve");
+}
+
+VisualShaderNodeBetterCurve::VisualShaderNodeBetterCurve() {
+	set_input_port_default_value(0, 0.0);
+}
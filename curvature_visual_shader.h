@@ -0,0 +1,45 @@
+#ifndef CURVATURE_VISUAL_SHADER_H
+#define CURVATURE_VISUAL_SHADER_H
+
+#include "curvature.h"
+#include "scene/resources/visual_shader.h"
+
+// Evaluates a BetterCurve with code generated from its segments, so there's no texture fetch and no quantization.
+// The generated function is refreshed every time the curve changes.
+class VisualShaderNodeBetterCurve : public VisualShaderNode {
+	GDCLASS(VisualShaderNodeBetterCurve, VisualShaderNode);
+
+public:
+	virtual String get_caption() const override;
+
+	virtual int get_input_port_count() const override;
+	virtual PortType get_input_port_type(int p_port) const override;
+	virtual String get_input_port_name(int p_port) const override;
+
+	virtual int get_output_port_count() const override;
+	virtual PortType get_output_port_type(int p_port) const override;
+	virtual String get_output_port_name(int p_port) const override;
+
+	virtual String generate_global(Shader::Mode p_mode, VisualShader::Type p_type, int p_id) const override;
+	virtual String generate_code(Shader::Mode p_mode, VisualShader::Type p_type, int p_id, const String *p_input_vars, const String *p_output_vars, bool p_for_preview = false) const override;
+
+	virtual Vector<StringName> get_editable_properties() const override;
+	virtual Category get_category() const override { return CATEGORY_SCALAR; }
+
+	void set_curve(const Ref<BetterCurve> &p_curve);
+	Ref<BetterCurve> get_curve() const { return _curve; }
+
+	VisualShaderNodeBetterCurve();
+
+protected:
+	static void _bind_methods();
+
+private:
+	void _curve_changed();
+	// Unique per node, as every node adds its own function to the global code.
+	static String _get_function_name(VisualShader::Type p_type, int p_id);
+
+	Ref<BetterCurve> _curve;
+};
+
+#endif // CURVATURE_VISUAL_SHADER_H
@@ -1,7 +1,6 @@
 #include "curvature_editor_plugin.h"
 
 #include "core/input/input.h"
-#include "core/math/geometry_2d.h"
 #include "core/os/keyboard.h"
 #include "editor/editor_interface.h"
 #include "editor/editor_node.h"
@@ -36,7 +35,10 @@ void BetterCurveEdit::set_curve(Ref<BetterCurve> p_curve) {
 		curve->disconnect(BetterCurve::SIGNAL_RANGE_CHANGED, callable_mp(this, &BetterCurveEdit::_curve_changed));
 	}
 
+	_preview.unref();
+	grabbing = GRAB_NONE;
 	curve = p_curve;
+	_polylines_dirty = true;
 
 	if (curve.is_valid()) {
 		curve->connect_changed(callable_mp(this, &BetterCurveEdit::_curve_changed));
@@ -101,6 +103,7 @@ void BetterCurveEdit::_notification(int p_what) {
 		} break;
 		case NOTIFICATION_VISIBILITY_CHANGED: {
 			if (!is_visible()) {
+				_end_preview();
 				grabbing = GRAB_NONE;
 			}
 		} break;
@@ -121,9 +124,13 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 				toggle_linear(selected_index, selected_tangent_index);
 			} else if (selected_index != -1) {
 				if (grabbing == GRAB_ADD) {
-					curve->remove_point(selected_index); // Point is temporary, so remove directly from curve.
+					_end_preview(); // Point is temporary, so dropping the preview removes it.
 					set_selected_index(-1);
 				} else {
+					if (grabbing == GRAB_MOVE) {
+						_end_preview();
+						set_selected_index(initial_grab_index);
+					}
 					remove_point(selected_index);
 				}
 				grabbing = GRAB_NONE;
@@ -144,9 +151,8 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 
 		if (mb->get_button_index() == MouseButton::RIGHT || mb->get_button_index() == MouseButton::MIDDLE) {
 			if (mb->get_button_index() == MouseButton::RIGHT && grabbing == GRAB_MOVE) {
-				// Move a point to its old position.
-				curve->set_point_value(selected_index, initial_grab_pos.y);
-				curve->set_point_offset(selected_index, initial_grab_pos.x);
+				// Move a point to its old position, curve itself was never modified.
+				_end_preview();
 				set_selected_index(initial_grab_index);
 				hovered_index = get_point_at(mpos);
 				grabbing = GRAB_NONE;
@@ -161,7 +167,7 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 						set_selected_index(-1); // Nothing on the place of the click, just deselect the point.
 					} else {
 						if (grabbing == GRAB_ADD) {
-							curve->remove_point(point_to_remove); // Point is temporary, so remove directly from curve.
+							_end_preview(); // Point is temporary, so dropping the preview removes it.
 							set_selected_index(-1);
 						} else {
 							remove_point(point_to_remove);
@@ -194,6 +200,7 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 				if (selected_index < curve->get_point_count() - 1) {
 					initial_grab_right_tangent = curve->get_point_right_tangent(selected_index);
 				}
+				_begin_preview();
 			} else if (grabbing == GRAB_NONE) {
 				// Adding a new point. Insert a temporary point for the user to adjust, so it's not in the undo/redo.
 				Vector2 new_pos = get_world_pos(mpos).clamp(Vector2(0.0, curve->get_min_value()), Vector2(1.0, curve->get_max_value()));
@@ -205,7 +212,8 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 				new_pos.x = get_offset_without_collision(selected_index, new_pos.x, mpos.x >= get_view_pos(new_pos).x);
 
 				// Add a temporary point for the user to adjust before adding it permanently.
-				int new_idx = curve->add_point_no_update(new_pos);
+				_begin_preview();
+				int new_idx = _preview->add_point_no_update(new_pos);
 				set_selected_index(new_idx);
 				grabbing = GRAB_ADD;
 				initial_grab_pos = new_pos;
@@ -214,25 +222,26 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 	}
 
 	if (mb.is_valid() && mb->get_button_index() == MouseButton::LEFT && !mb->is_pressed()) {
+		// The preview's final state is applied to curve as a single action.
+		const Ref<BetterCurve> edited = _get_shown_curve();
+		_end_preview();
 		if (selected_tangent_index != TANGENT_NONE) {
 			// Finish moving a tangent control.
 			if (selected_index == 0) {
-				set_point_right_tangent(selected_index, curve->get_point_right_tangent(selected_index));
-			} else if (selected_index == curve->get_point_count() - 1) {
-				set_point_left_tangent(selected_index, curve->get_point_left_tangent(selected_index));
+				set_point_right_tangent(selected_index, edited->get_point_right_tangent(selected_index));
+			} else if (selected_index == edited->get_point_count() - 1) {
+				set_point_left_tangent(selected_index, edited->get_point_left_tangent(selected_index));
 			} else {
-				set_point_tangents(selected_index, curve->get_point_left_tangent(selected_index), curve->get_point_right_tangent(selected_index));
+				set_point_tangents(selected_index, edited->get_point_left_tangent(selected_index), edited->get_point_right_tangent(selected_index));
 			}
 			grabbing = GRAB_NONE;
 		} else if (grabbing == GRAB_MOVE) {
 			// Finish moving a point.
-			set_point_position(selected_index, curve->get_point_position(selected_index));
+			set_point_position(selected_index, edited->get_point_position(selected_index));
 			grabbing = GRAB_NONE;
 		} else if (grabbing == GRAB_ADD) {
-			// Finish inserting a new point. Remove the temporary point and insert a permanent one in its place.
-			Vector2 new_pos = curve->get_point_position(selected_index);
-			curve->remove_point(selected_index);
-			add_point(new_pos);
+			// Finish inserting a new point, the temporary one only ever existed in the preview.
+			add_point(edited->get_point_position(selected_index), selected_index);
 			grabbing = GRAB_NONE;
 		}
 		queue_redraw();
@@ -243,14 +252,16 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 		Vector2 mpos = mm->get_position();
 
 		if (grabbing != GRAB_NONE && curve.is_valid()) {
+			// Only the preview is modified, so motion triggers neither a bake nor an undo action.
+			const Ref<BetterCurve> &edited = _get_shown_curve();
 			if (selected_index != -1) {
 				if (selected_tangent_index == TANGENT_NONE) {
 					// Drag point.
-					Vector2 new_pos = get_world_pos(mpos).clamp(Vector2(0.0, curve->get_min_value()), Vector2(1.0, curve->get_max_value()));
+					Vector2 new_pos = get_world_pos(mpos).clamp(Vector2(0.0, edited->get_min_value()), Vector2(1.0, edited->get_max_value()));
 
 					if (snap_enabled || mm->is_command_or_control_pressed()) {
 						new_pos.x = Math::snapped(new_pos.x, 1.0 / snap_count);
-						new_pos.y = Math::snapped(new_pos.y - curve->get_min_value(), curve->get_range() / snap_count) + curve->get_min_value();
+						new_pos.y = Math::snapped(new_pos.y - edited->get_min_value(), edited->get_range() / snap_count) + edited->get_min_value();
 					}
 
 					// Allow to snap to axes with Shift.
@@ -265,25 +276,25 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 
 					// Allow to constraint the point between the adjacent two with Alt.
 					if (mm->is_alt_pressed()) {
-						float prev_point_offset = (selected_index > 0) ? (curve->get_point_position(selected_index - 1).x + 0.00001) : 0.0;
-						float next_point_offset = (selected_index < curve->get_point_count() - 1) ? (curve->get_point_position(selected_index + 1).x - 0.00001) : 1.0;
+						float prev_point_offset = (selected_index > 0) ? (edited->get_point_position(selected_index - 1).x + 0.00001) : 0.0;
+						float next_point_offset = (selected_index < edited->get_point_count() - 1) ? (edited->get_point_position(selected_index + 1).x - 0.00001) : 1.0;
 						new_pos.x = CLAMP(new_pos.x, prev_point_offset, next_point_offset);
 					}
 
 					new_pos.x = get_offset_without_collision(selected_index, new_pos.x, mpos.x >= get_view_pos(new_pos).x);
 
 					// The index may change if the point is dragged across another one.
-					int i = curve->set_point_offset(selected_index, new_pos.x);
+					int i = edited->set_point_offset(selected_index, new_pos.x);
 					hovered_index = i;
 					set_selected_index(i);
 
-					new_pos.y = CLAMP(new_pos.y, curve->get_min_value(), curve->get_max_value());
-					curve->set_point_value(selected_index, new_pos.y);
+					new_pos.y = CLAMP(new_pos.y, edited->get_min_value(), edited->get_max_value());
+					edited->set_point_value(selected_index, new_pos.y);
 
 				} else {
 					// Drag tangent.
 
-					const Vector2 new_pos = curve->get_point_position(selected_index);
+					const Vector2 new_pos = edited->get_point_position(selected_index);
 					const Vector2 control_pos = get_world_pos(mpos);
 
 					Vector2 dir = (control_pos - new_pos).normalized();
@@ -294,23 +305,24 @@ void BetterCurveEdit::gui_input(const Ref<InputEvent> &p_event) {
 
 					// Adjust the tangents.
 					if (selected_tangent_index == TANGENT_LEFT) {
-						curve->set_point_left_tangent(selected_index, tangent);
+						edited->set_point_left_tangent(selected_index, tangent);
 
 						// Align the other tangent if it isn't linear and Shift is not pressed.
 						// If Shift is pressed at any point, restore the initial angle of the other tangent.
-						if (selected_index != (curve->get_point_count() - 1) && curve->get_point_right_mode(selected_index) != BetterCurve::TANGENT_LINEAR) {
-							curve->set_point_right_tangent(selected_index, mm->is_shift_pressed() ? initial_grab_right_tangent : tangent);
+						if (selected_index != (edited->get_point_count() - 1) && edited->get_point_right_mode(selected_index) != BetterCurve::TANGENT_LINEAR) {
+							edited->set_point_right_tangent(selected_index, mm->is_shift_pressed() ? initial_grab_right_tangent : tangent);
 						}
 
 					} else {
-						curve->set_point_right_tangent(selected_index, tangent);
+						edited->set_point_right_tangent(selected_index, tangent);
 
-						if (selected_index != 0 && curve->get_point_left_mode(selected_index) != BetterCurve::TANGENT_LINEAR) {
-							curve->set_point_left_tangent(selected_index, mm->is_shift_pressed() ? initial_grab_left_tangent : tangent);
+						if (selected_index != 0 && edited->get_point_left_mode(selected_index) != BetterCurve::TANGENT_LINEAR) {
+							edited->set_point_left_tangent(selected_index, mm->is_shift_pressed() ? initial_grab_left_tangent : tangent);
 						}
 					}
 				}
 			}
+			queue_redraw();
 		} else {
 			// Grab mode is GRAB_NONE, so do hovering logic.
 			hovered_index = get_point_at(mpos);
@@ -325,6 +337,7 @@ void BetterCurveEdit::use_preset(int p_preset_id) {
 	ERR_FAIL_COND(curve.is_null());
 
 	Array previous_data = curve->get_data();
+	curve->begin_edit();
 	curve->clear_points();
 
 	float min_value = curve->get_min_value();
@@ -363,6 +376,7 @@ void BetterCurveEdit::use_preset(int p_preset_id) {
 		default:
 			break;
 	}
+	curve->commit_edit();
 
 	EditorUndoRedoManager *undo_redo = EditorUndoRedoManager::get_singleton();
 	undo_redo->create_action(TTR("Load BetterCurve Preset"));
@@ -385,14 +399,15 @@ int BetterCurveEdit::get_point_at(Vector2 p_pos) const {
 	if (curve.is_null()) {
 		return -1;
 	}
+	const Ref<BetterCurve> &shown = _get_shown_curve();
 
 	// Use a square-shaped hover region. If hovering multiple points, pick the closer one.
 	const Rect2 hover_rect = Rect2(p_pos, Vector2(0, 0)).grow(hover_radius);
 	int closest_idx = -1;
 	float closest_dist_squared = hover_radius * hover_radius * 2;
 
-	for (int i = 0; i < curve->get_point_count(); ++i) {
-		Vector2 p = get_view_pos(curve->get_point_position(i));
+	for (int i = 0; i < shown->get_point_count(); ++i) {
+		Vector2 p = get_view_pos(shown->get_point_position(i));
 		if (hover_rect.has_point(p) && p.distance_squared_to(p_pos) < closest_dist_squared) {
 			closest_dist_squared = p.distance_squared_to(p_pos);
 			closest_idx = i;
@@ -406,6 +421,7 @@ BetterCurveEdit::TangentIndex BetterCurveEdit::get_tangent_at(Vector2 p_pos) con
 	if (curve.is_null() || selected_index < 0) {
 		return TANGENT_NONE;
 	}
+	const Ref<BetterCurve> &shown = _get_shown_curve();
 
 	const Rect2 hover_rect = Rect2(p_pos, Vector2(0, 0)).grow(tangent_hover_radius);
 
@@ -416,7 +432,7 @@ BetterCurveEdit::TangentIndex BetterCurveEdit::get_tangent_at(Vector2 p_pos) con
 		}
 	}
 
-	if (selected_index != curve->get_point_count() - 1) {
+	if (selected_index != shown->get_point_count() - 1) {
 		Vector2 control_pos = get_tangent_view_pos(selected_index, TANGENT_RIGHT);
 		if (hover_rect.has_point(control_pos)) {
 			return TANGENT_RIGHT;
@@ -428,19 +444,20 @@ BetterCurveEdit::TangentIndex BetterCurveEdit::get_tangent_at(Vector2 p_pos) con
 
 // FIXME: This function should be bounded better.
 float BetterCurveEdit::get_offset_without_collision(int p_current_index, float p_offset, bool p_prioritize_right) {
+	const Ref<BetterCurve> &shown = _get_shown_curve();
 	float safe_offset = p_offset;
 	bool prioritizing_right = p_prioritize_right;
 
-	for (int i = 0; i < curve->get_point_count(); i++) {
+	for (int i = 0; i < shown->get_point_count(); i++) {
 		if (i == p_current_index) {
 			continue;
 		}
 
-		if (curve->get_point_position(i).x > safe_offset) {
+		if (shown->get_point_position(i).x > safe_offset) {
 			break;
 		}
 
-		if (curve->get_point_position(i).x == safe_offset) {
+		if (shown->get_point_position(i).x == safe_offset) {
 			if (prioritizing_right) {
 				safe_offset += 0.00001;
 				if (safe_offset > 1.0) {
@@ -461,12 +478,11 @@ float BetterCurveEdit::get_offset_without_collision(int p_current_index, float p
 	return safe_offset;
 }
 
-void BetterCurveEdit::add_point(Vector2 p_pos) {
+void BetterCurveEdit::add_point(Vector2 p_pos, int p_new_index) {
 	ERR_FAIL_COND(curve.is_null());
 
-	// Add a point to get its index, then remove it immediately. Trick to feed the UndoRedo.
-	int new_idx = curve->add_point(p_pos);
-	curve->remove_point(new_idx);
+	// The preview already told where the point goes, so curve isn't modified to find out.
+	int new_idx = p_new_index;
 
 	EditorUndoRedoManager *undo_redo = EditorUndoRedoManager::get_singleton();
 	undo_redo->create_action(TTR("Add BetterCurve Point"));
@@ -509,9 +525,6 @@ void BetterCurveEdit::set_point_position(int p_index, Vector2 p_pos) {
 		return;
 	}
 
-	// Pretend the point started from its old place.
-	curve->set_point_value(p_index, initial_grab_pos.y);
-	curve->set_point_offset(p_index, initial_grab_pos.x);
 	// Note: Changing the offset may modify the order.
 	EditorUndoRedoManager *undo_redo = EditorUndoRedoManager::get_singleton();
 	undo_redo->create_action(TTR("Modify BetterCurve Point"));
@@ -536,8 +549,6 @@ void BetterCurveEdit::set_point_tangents(int p_index, float p_left, float p_righ
 		return;
 	}
 
-	curve->set_point_left_tangent(p_index, initial_grab_left_tangent);
-	curve->set_point_right_tangent(p_index, initial_grab_right_tangent);
 	EditorUndoRedoManager *undo_redo = EditorUndoRedoManager::get_singleton();
 	undo_redo->create_action(TTR("Modify BetterCurve Point's Tangents"));
 	undo_redo->add_do_method(*curve, "set_point_left_tangent", p_index, p_left);
@@ -557,7 +568,6 @@ void BetterCurveEdit::set_point_left_tangent(int p_index, float p_tangent) {
 		return;
 	}
 
-	curve->set_point_left_tangent(p_index, initial_grab_left_tangent);
 	EditorUndoRedoManager *undo_redo = EditorUndoRedoManager::get_singleton();
 	undo_redo->create_action(TTR("Modify BetterCurve Point's Left Tangent"));
 	undo_redo->add_do_method(*curve, "set_point_left_tangent", p_index, p_tangent);
@@ -575,7 +585,6 @@ void BetterCurveEdit::set_point_right_tangent(int p_index, float p_tangent) {
 		return;
 	}
 
-	curve->set_point_right_tangent(p_index, initial_grab_right_tangent);
 	EditorUndoRedoManager *undo_redo = EditorUndoRedoManager::get_singleton();
 	undo_redo->create_action(TTR("Modify BetterCurve Point's Right Tangent"));
 	undo_redo->add_do_method(*curve, "set_point_right_tangent", p_index, p_tangent);
@@ -614,6 +623,26 @@ void BetterCurveEdit::toggle_linear(int p_index, TangentIndex p_tangent) {
 	undo_redo->commit_action();
 }
 
+void BetterCurveEdit::_begin_preview() {
+	ERR_FAIL_COND(curve.is_null());
+	// Never sampled, so the lazy mode means it never bakes either.
+	_preview.instantiate();
+	_preview->set_bake_mode(BetterCurve::BAKE_MODE_LAZY);
+	_preview->set_min_value(curve->get_min_value());
+	_preview->set_max_value(curve->get_max_value());
+	_preview->set_data(curve->get_data());
+	_polylines_dirty = true;
+}
+
+void BetterCurveEdit::_end_preview() {
+	if (_preview.is_null()) {
+		return;
+	}
+	_preview.unref();
+	_polylines_dirty = true;
+	queue_redraw();
+}
+
 void BetterCurveEdit::set_selected_index(int p_index) {
 	if (p_index != selected_index) {
 		selected_index = p_index;
@@ -646,14 +675,15 @@ void BetterCurveEdit::update_view_transform() {
 }
 
 Vector2 BetterCurveEdit::get_tangent_view_pos(int p_index, TangentIndex p_tangent) const {
+	const Ref<BetterCurve> &shown = _get_shown_curve();
 	Vector2 dir;
 	if (p_tangent == TANGENT_LEFT) {
-		dir = -Vector2(1, curve->get_point_left_tangent(p_index));
+		dir = -Vector2(1, shown->get_point_left_tangent(p_index));
 	} else {
-		dir = Vector2(1, curve->get_point_right_tangent(p_index));
+		dir = Vector2(1, shown->get_point_right_tangent(p_index));
 	}
 
-	Vector2 point_pos = curve->get_point_position(p_index);
+	Vector2 point_pos = shown->get_point_position(p_index);
 	Vector2 point_view_pos = get_view_pos(point_pos);
 	Vector2 control_view_pos = get_view_pos(point_pos + dir);
 
@@ -691,7 +721,8 @@ static void plot_curve_accurate(const BetterCurve &curve, float step, Vector2 sc
 	if (curve.get_point_count() <= 1) {
 		// Not enough points to make a curve, so it's just a straight line.
 		// The added tiny vectors make the drawn line stay exactly within the bounds in practice.
-		float y = curve.sample(0);
+		BetterCurve::SegmentsRef segments = curve.get_segments();
+		float y = segments ? segments->first_y : 0.0;
 		plot_func(Vector2(0, y) * scaling + Vector2(0.5, 0), Vector2(1.f, y) * scaling - Vector2(1.5, 0), true);
 
 	} else {
@@ -704,6 +735,8 @@ static void plot_curve_accurate(const BetterCurve &curve, float step, Vector2 sc
 
 		// Draw section by section, so that we get maximum precision near points.
 		// It's an accurate representation, but slower than using the baked one.
+		BetterCurve::SegmentsRef segments = curve.get_segments();
+		ERR_FAIL_COND(!segments || segments->get_count() != curve.get_point_count() - 1);
 		for (int i = 1; i < curve.get_point_count(); ++i) {
 			Vector2 a = curve.get_point_position(i - 1);
 			Vector2 b = curve.get_point_position(i);
@@ -717,7 +750,7 @@ static void plot_curve_accurate(const BetterCurve &curve, float step, Vector2 sc
 			for (int j = 1; j < samples; j++) {
 				float x = j * scaled_step;
 				pos.x = a.x + x;
-				pos.y = curve.sample_local_nocheck(i - 1, x);
+				pos.y = segments->evaluate(i - 1, x);
 				plot_func(prev_pos * scaling, pos * scaling, true);
 				prev_pos = pos;
 			}
@@ -727,25 +760,45 @@ static void plot_curve_accurate(const BetterCurve &curve, float step, Vector2 sc
 	}
 }
 
-struct CanvasItemPlotBetterCurve {
-	CanvasItem &ci;
-	Color color1;
-	Color color2;
+// Joins the plotted lines into polylines, starting a new one wherever a line doesn't continue the previous one.
+template <typename Run>
+struct PolylinePlotBetterCurve {
+	LocalVector<Run> &runs;
 
-	CanvasItemPlotBetterCurve(CanvasItem &p_ci, Color p_color1, Color p_color2) :
-			ci(p_ci),
-			color1(p_color1),
-			color2(p_color2) {}
+	PolylinePlotBetterCurve(LocalVector<Run> &p_runs) :
+			runs(p_runs) {}
 
 	void operator()(Vector2 pos0, Vector2 pos1, bool in_definition) {
-		ci.draw_line(pos0, pos1, in_definition ? color1 : color2, 0.5, true);
+		if (runs.is_empty() || runs[runs.size() - 1].in_definition != in_definition || runs[runs.size() - 1].points[runs[runs.size() - 1].points.size() - 1] != pos0) {
+			Run run;
+			run.in_definition = in_definition;
+			run.points.push_back(pos0);
+			runs.push_back(run);
+		}
+		runs[runs.size() - 1].points.push_back(pos1);
 	}
 };
 
+void BetterCurveEdit::_update_polylines() {
+	const Ref<BetterCurve> &shown = _get_shown_curve();
+	const uint32_t version = shown->get_segments_version();
+	if (!_polylines_dirty && version == _polylines_segments_version && _world_to_view == _polylines_transform) {
+		return;
+	}
+	_polylines_dirty = false;
+	_polylines_segments_version = version;
+	_polylines_transform = _world_to_view;
+
+	_polylines.clear();
+	PolylinePlotBetterCurve<PolylineRun> plot_func(_polylines);
+	plot_curve_accurate(**shown, 2.f, (get_view_pos(Vector2(1, shown->get_max_value())) - get_view_pos(Vector2(0, shown->get_min_value()))) / Vector2(1, shown->get_range()), plot_func);
+}
+
 void BetterCurveEdit::_redraw() {
 	if (curve.is_null()) {
 		return;
 	}
+	const Ref<BetterCurve> &shown = _get_shown_curve();
 
 	update_view_transform();
 
@@ -764,10 +817,10 @@ void BetterCurveEdit::_redraw() {
 	const Color grid_color = get_theme_color(SNAME("mono_color"), EditorStringName(Editor)) * Color(1, 1, 1, 0.1);
 
 	const Vector2i grid_steps = Vector2i(4, 2);
-	const Vector2 step_size = Vector2(1, curve->get_range()) / grid_steps;
+	const Vector2 step_size = Vector2(1, shown->get_range()) / grid_steps;
 
-	draw_line(Vector2(min_edge.x, curve->get_min_value()), Vector2(max_edge.x, curve->get_min_value()), grid_color_primary);
-	draw_line(Vector2(max_edge.x, curve->get_max_value()), Vector2(min_edge.x, curve->get_max_value()), grid_color_primary);
+	draw_line(Vector2(min_edge.x, shown->get_min_value()), Vector2(max_edge.x, shown->get_min_value()), grid_color_primary);
+	draw_line(Vector2(max_edge.x, shown->get_max_value()), Vector2(min_edge.x, shown->get_max_value()), grid_color_primary);
 	draw_line(Vector2(0, min_edge.y), Vector2(0, max_edge.y), grid_color_primary);
 	draw_line(Vector2(1, max_edge.y), Vector2(1, min_edge.y), grid_color_primary);
 
@@ -777,7 +830,7 @@ void BetterCurveEdit::_redraw() {
 	}
 
 	for (int i = 1; i < grid_steps.y; i++) {
-		real_t y = curve->get_min_value() + i * step_size.y;
+		real_t y = shown->get_min_value() + i * step_size.y;
 		draw_line(Vector2(min_edge.x, y), Vector2(max_edge.x, y), grid_color);
 	}
 
@@ -791,11 +844,11 @@ void BetterCurveEdit::_redraw() {
 
 	for (int i = 0; i <= grid_steps.x; ++i) {
 		real_t x = i * step_size.x;
-		draw_string(font, get_view_pos(Vector2(x - step_size.x / 2, curve->get_min_value())) + Vector2(0, font_height - Math::round(2 * EDSCALE)), String::num(x, 2), HORIZONTAL_ALIGNMENT_CENTER, get_view_pos(Vector2(step_size.x, 0)).x, font_size, text_color);
+		draw_string(font, get_view_pos(Vector2(x - step_size.x / 2, shown->get_min_value())) + Vector2(0, font_height - Math::round(2 * EDSCALE)), String::num(x, 2), HORIZONTAL_ALIGNMENT_CENTER, get_view_pos(Vector2(step_size.x, 0)).x, font_size, text_color);
 	}
 
 	for (int i = 0; i <= grid_steps.y; ++i) {
-		real_t y = curve->get_min_value() + i * step_size.y;
+		real_t y = shown->get_min_value() + i * step_size.y;
 		draw_string(font, get_view_pos(Vector2(0, y)) + Vector2(2, -2), String::num(y, 2), HORIZONTAL_ALIGNMENT_LEFT, -1, font_size, text_color);
 	}
 
@@ -808,8 +861,10 @@ void BetterCurveEdit::_redraw() {
 	const Color line_color = get_theme_color(SceneStringName(font_color), EditorStringName(Editor));
 	const Color edge_line_color = get_theme_color(SceneStringName(font_color), EditorStringName(Editor)) * Color(1, 1, 1, 0.75);
 
-	CanvasItemPlotBetterCurve plot_func(*this, line_color, edge_line_color);
-	plot_curve_accurate(**curve, 2.f, (get_view_pos(Vector2(1, curve->get_max_value())) - get_view_pos(Vector2(0, curve->get_min_value()))) / Vector2(1, curve->get_range()), plot_func);
+	_update_polylines();
+	for (const PolylineRun &run : _polylines) {
+		draw_polyline(run.points, run.in_definition ? line_color : edge_line_color, 0.5, true);
+	}
 
 	// Draw points, except for the selected one.
 	draw_set_transform_matrix(Transform2D());
@@ -818,8 +873,8 @@ void BetterCurveEdit::_redraw() {
 
 	const Color point_color = get_theme_color(SceneStringName(font_color), EditorStringName(Editor));
 
-	for (int i = 0; i < curve->get_point_count(); ++i) {
-		Vector2 pos = get_view_pos(curve->get_point_position(i));
+	for (int i = 0; i < shown->get_point_count(); ++i) {
+		Vector2 pos = get_view_pos(shown->get_point_position(i));
 		if (selected_index != i) {
 			draw_rect(Rect2(pos, Vector2(0, 0)).grow(point_radius), point_color);
 		}
@@ -831,7 +886,7 @@ void BetterCurveEdit::_redraw() {
 	// Draw selected point and its tangents.
 
 	if (selected_index >= 0) {
-		const Vector2 point_pos = curve->get_point_position(selected_index);
+		const Vector2 point_pos = shown->get_point_position(selected_index);
 		const Color selected_point_color = get_theme_color(SNAME("accent_color"), EditorStringName(Editor));
 
 		// Draw tangents if not dragging a point, or if holding a point without having moved it yet.
@@ -845,30 +900,30 @@ void BetterCurveEdit::_redraw() {
 
 				draw_line(get_view_pos(point_pos), control_pos, left_tangent_color, 0.5 * EDSCALE, true);
 				// Square for linear mode, circle otherwise.
-				if (curve->get_point_left_mode(selected_index) == BetterCurve::TANGENT_FREE) {
+				if (shown->get_point_left_mode(selected_index) == BetterCurve::TANGENT_FREE) {
 					draw_circle(control_pos, tangent_radius, left_tangent_color);
 				} else {
 					draw_rect(Rect2(control_pos, Vector2(0, 0)).grow(tangent_radius), left_tangent_color);
 				}
 				// Hover indicator.
-				if (hovered_tangent_index == TANGENT_LEFT || (hovered_tangent_index == TANGENT_RIGHT && !shift_pressed && curve->get_point_left_mode(selected_index) != BetterCurve::TANGENT_LINEAR)) {
+				if (hovered_tangent_index == TANGENT_LEFT || (hovered_tangent_index == TANGENT_RIGHT && !shift_pressed && shown->get_point_left_mode(selected_index) != BetterCurve::TANGENT_LINEAR)) {
 					draw_rect(Rect2(control_pos, Vector2(0, 0)).grow(tangent_hover_radius - Math::round(3 * EDSCALE)), tangent_color, false, Math::round(1 * EDSCALE));
 				}
 			}
 
-			if (selected_index != curve->get_point_count() - 1) {
+			if (selected_index != shown->get_point_count() - 1) {
 				Vector2 control_pos = get_tangent_view_pos(selected_index, TANGENT_RIGHT);
 				Color right_tangent_color = (selected_tangent_index == TANGENT_RIGHT) ? selected_tangent_color : tangent_color;
 
 				draw_line(get_view_pos(point_pos), control_pos, right_tangent_color, 0.5 * EDSCALE, true);
 				// Square for linear mode, circle otherwise.
-				if (curve->get_point_right_mode(selected_index) == BetterCurve::TANGENT_FREE) {
+				if (shown->get_point_right_mode(selected_index) == BetterCurve::TANGENT_FREE) {
 					draw_circle(control_pos, tangent_radius, right_tangent_color);
 				} else {
 					draw_rect(Rect2(control_pos, Vector2(0, 0)).grow(tangent_radius), right_tangent_color);
 				}
 				// Hover indicator.
-				if (hovered_tangent_index == TANGENT_RIGHT || (hovered_tangent_index == TANGENT_LEFT && !shift_pressed && curve->get_point_right_mode(selected_index) != BetterCurve::TANGENT_LINEAR)) {
+				if (hovered_tangent_index == TANGENT_RIGHT || (hovered_tangent_index == TANGENT_LEFT && !shift_pressed && shown->get_point_right_mode(selected_index) != BetterCurve::TANGENT_LINEAR)) {
 					draw_rect(Rect2(control_pos, Vector2(0, 0)).grow(tangent_hover_radius - Math::round(3 * EDSCALE)), tangent_color, false, Math::round(1 * EDSCALE));
 				}
 			}
@@ -879,14 +934,14 @@ void BetterCurveEdit::_redraw() {
 
 	// Draw help text.
 
-	if (selected_index > 0 && selected_index < curve->get_point_count() - 1 && selected_tangent_index == TANGENT_NONE && hovered_tangent_index != TANGENT_NONE && !shift_pressed) {
+	if (selected_index > 0 && selected_index < shown->get_point_count() - 1 && selected_tangent_index == TANGENT_NONE && hovered_tangent_index != TANGENT_NONE && !shift_pressed) {
 		float width = view_size.x - 50 * EDSCALE;
 		text_color.a *= 0.4;
 
 		draw_multiline_string(font, Vector2(25 * EDSCALE, font_height - Math::round(2 * EDSCALE)), TTR("Hold Shift to edit tangents individually"), HORIZONTAL_ALIGNMENT_CENTER, width, font_size, -1, text_color);
 
 	} else if (selected_index != -1 && selected_tangent_index == TANGENT_NONE) {
-		const Vector2 point_pos = curve->get_point_position(selected_index);
+		const Vector2 point_pos = shown->get_point_position(selected_index);
 		float width = view_size.x - 50 * EDSCALE;
 		text_color.a *= 0.8;
 
@@ -895,7 +950,7 @@ void BetterCurveEdit::_redraw() {
 	} else if (selected_index != -1 && selected_tangent_index != TANGENT_NONE) {
 		float width = view_size.x - 50 * EDSCALE;
 		text_color.a *= 0.8;
-		real_t theta = Math::rad_to_deg(Math::atan(selected_tangent_index == TANGENT_LEFT ? -1 * curve->get_point_left_tangent(selected_index) : curve->get_point_right_tangent(selected_index)));
+		real_t theta = Math::rad_to_deg(Math::atan(selected_tangent_index == TANGENT_LEFT ? -1 * shown->get_point_left_tangent(selected_index) : shown->get_point_right_tangent(selected_index)));
 
 		draw_string(font, Vector2(25 * EDSCALE, font_height - Math::round(2 * EDSCALE)), String::num(theta, 1) + String::utf8(" °"), HORIZONTAL_ALIGNMENT_CENTER, width, font_size, text_color);
 	}
@@ -904,15 +959,15 @@ void BetterCurveEdit::_redraw() {
 	draw_set_transform_matrix(_world_to_view);
 
 	if (Input::get_singleton()->is_key_pressed(Key::ALT) && grabbing != GRAB_NONE && selected_tangent_index == TANGENT_NONE) {
-		float prev_point_offset = (selected_index > 0) ? curve->get_point_position(selected_index - 1).x : 0.0;
-		float next_point_offset = (selected_index < curve->get_point_count() - 1) ? curve->get_point_position(selected_index + 1).x : 1.0;
+		float prev_point_offset = (selected_index > 0) ? shown->get_point_position(selected_index - 1).x : 0.0;
+		float next_point_offset = (selected_index < shown->get_point_count() - 1) ? shown->get_point_position(selected_index + 1).x : 1.0;
 
-		draw_line(Vector2(prev_point_offset, curve->get_min_value()), Vector2(prev_point_offset, curve->get_max_value()), Color(point_color, 0.6));
-		draw_line(Vector2(next_point_offset, curve->get_min_value()), Vector2(next_point_offset, curve->get_max_value()), Color(point_color, 0.6));
+		draw_line(Vector2(prev_point_offset, shown->get_min_value()), Vector2(prev_point_offset, shown->get_max_value()), Color(point_color, 0.6));
+		draw_line(Vector2(next_point_offset, shown->get_min_value()), Vector2(next_point_offset, shown->get_max_value()), Color(point_color, 0.6));
 	}
 
 	if (shift_pressed && grabbing != GRAB_NONE && selected_tangent_index == TANGENT_NONE) {
-		draw_line(Vector2(initial_grab_pos.x, curve->get_min_value()), Vector2(initial_grab_pos.x, curve->get_max_value()), get_theme_color(SNAME("axis_x_color"), EditorStringName(Editor)).darkened(0.4));
+		draw_line(Vector2(initial_grab_pos.x, shown->get_min_value()), Vector2(initial_grab_pos.x, shown->get_max_value()), get_theme_color(SNAME("axis_x_color"), EditorStringName(Editor)).darkened(0.4));
 		draw_line(Vector2(0, initial_grab_pos.y), Vector2(1, initial_grab_pos.y), get_theme_color(SNAME("axis_y_color"), EditorStringName(Editor)).darkened(0.4));
 	}
 }
@@ -1041,31 +1096,47 @@ Ref<Texture2D> BetterCurvePreviewGenerator::generate(const Ref<Resource> &p_from
 		return Ref<Texture2D>();
 	}
 
-	Ref<Image> img_ref;
-	img_ref.instantiate();
-	Image &im = **img_ref;
-	im.initialize_data(p_size.x, p_size.y, false, Image::FORMAT_RGBA8);
-
-	Color line_color = EditorInterface::get_singleton()->get_editor_theme()->get_color(SceneStringName(font_color), EditorStringName(Editor));
-
-	// Set the first pixel of the thumbnail.
-	float v = (curve->sample_baked(0) - curve->get_min_value()) / curve->get_range();
-	int y = CLAMP(im.get_height() - v * im.get_height(), 0, im.get_height() - 1);
-	im.set_pixel(0, y, line_color);
+	const int width = p_size.x;
+	const int height = p_size.y;
+	ERR_FAIL_COND_V(width <= 0 || height <= 0, Ref<Texture2D>());
 
-	// Plot a line towards the next point.
-	int prev_y = y;
-	for (int x = 1; x < im.get_width(); ++x) {
-		float t = static_cast<float>(x) / im.get_width();
-		v = (curve->sample_baked(t) - curve->get_min_value()) / curve->get_range();
-		y = CLAMP(im.get_height() - v * im.get_height(), 0, im.get_height() - 1);
+	const Color line_color = EditorInterface::get_singleton()->get_editor_theme()->get_color(SceneStringName(font_color), EditorStringName(Editor));
+	const uint8_t pixel[4] = { (uint8_t)line_color.get_r8(), (uint8_t)line_color.get_g8(), (uint8_t)line_color.get_b8(), (uint8_t)line_color.get_a8() };
 
-		Vector<Point2i> points = Geometry2D::bresenham_line(Point2i(x - 1, prev_y), Point2i(x, y));
-		for (Point2i point : points) {
-			im.set_pixelv(point, line_color);
+	// One snapshot for every column. Nothing below touches the scene, so thumbnails can be generated on the preview thread.
+	LocalVector<real_t> offsets;
+	LocalVector<real_t> values;
+	offsets.resize(width);
+	values.resize(width);
+	for (int x = 0; x < width; ++x) {
+		offsets[x] = static_cast<real_t>(x) / width;
+	}
+	curve->sample_n(offsets.ptr(), values.ptr(), width);
+
+	Vector<uint8_t> data;
+	data.resize(width * height * 4);
+	uint8_t *w = data.ptrw();
+	memset(w, 0, data.size());
+
+	// Each column is filled from the previous column's height to its own, so steep parts stay connected.
+	const real_t min_value = curve->get_min_value();
+	const real_t range = curve->get_range();
+	int prev_y = 0;
+	for (int x = 0; x < width; ++x) {
+		float v = (values[x] - min_value) / range;
+		int y = CLAMP(height - v * height, 0, height - 1);
+		if (x == 0) {
+			prev_y = y;
+		}
+		const int from = MIN(prev_y, y);
+		const int to = MAX(prev_y, y);
+		uint8_t *dst = w + (from * width + x) * 4;
+		for (int row = from; row <= to; ++row, dst += width * 4) {
+			memcpy(dst, pixel, 4);
 		}
 		prev_y = y;
 	}
 
+	Ref<Image> img_ref = memnew(Image(width, height, false, Image::FORMAT_RGBA8, data));
 	return ImageTexture::create_from_image(img_ref);
 }
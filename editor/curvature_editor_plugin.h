@@ -2,6 +2,7 @@
 #define CURVATURE_EDITOR_PLUGIN_H
 
 #include "../curvature.h"
+#include "core/templates/local_vector.h"
 #include "editor/editor_inspector.h"
 #include "editor/editor_resource_preview.h"
 #include "editor/plugins/editor_plugin.h"
@@ -53,7 +54,7 @@ private:
 
 	float get_offset_without_collision(int p_current_index, float p_offset, bool p_prioritize_right = true);
 
-	void add_point(Vector2 p_pos);
+	void add_point(Vector2 p_pos, int p_new_index);
 	void remove_point(int p_index);
 	void set_point_position(int p_index, Vector2 p_pos);
 
@@ -72,13 +73,31 @@ private:
 	Vector2 get_world_pos(Vector2 p_view_pos) const;
 
 	void _redraw();
+	void _update_polylines();
+
+	void _begin_preview();
+	void _end_preview();
+	// The drag preview while there's one, the edited curve otherwise.
+	const Ref<BetterCurve> &_get_shown_curve() const { return _preview.is_valid() ? _preview : curve; }
 
 private:
 	const float ASPECT_RATIO = 6.f / 13.f;
 
 	Transform2D _world_to_view;
 
+	struct PolylineRun {
+		PackedVector2Array points;
+		bool in_definition = true;
+	};
+	// The plotted curve, only rebuilt when its segments or the view transform change.
+	LocalVector<PolylineRun> _polylines;
+	Transform2D _polylines_transform;
+	uint32_t _polylines_segments_version = 0;
+	bool _polylines_dirty = true;
+
 	Ref<BetterCurve> curve;
+	// Copy of curve that drags edit, so that curve is only modified once, on release.
+	Ref<BetterCurve> _preview;
 	PopupMenu *_presets_menu = nullptr;
 
 	int selected_index = -1;
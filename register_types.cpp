@@ -25,13 +25,33 @@
 
 #include "core/object/class_db.h"
 #include "curvature.h"
+#include "curvature_bake_scheduler.h"
+#include "curvature_cache_interner.h"
+#include "curvature_cursor.h"
+#include "curvature_evaluator.h"
+#include "curvature_multi.h"
+#include "curvature_stats.h"
+#include "curvature_texture.h"
+#include "curvature_visual_shader.h"
 #ifdef TOOLS_ENABLED
 #include "editor/curvature_editor_plugin.h"
 #endif
 
+static BetterCurveBakeScheduler *bake_scheduler = nullptr;
+static BetterCurveCacheInterner *cache_interner = nullptr;
+
 void initialize_curvature_module(ModuleInitializationLevel p_level) {
 	if (p_level == MODULE_INITIALIZATION_LEVEL_SCENE) {
+		cache_interner = memnew(BetterCurveCacheInterner);
+		bake_scheduler = memnew(BetterCurveBakeScheduler);
 		GDREGISTER_CLASS(BetterCurve);
+		GDREGISTER_CLASS(BetterCurveCursor);
+		GDREGISTER_CLASS(BetterCurveEvaluator);
+		GDREGISTER_CLASS(BetterCurveN);
+		GDREGISTER_CLASS(BetterCurveTexture);
+		GDREGISTER_CLASS(BetterCurveAtlasTexture);
+		GDREGISTER_CLASS(VisualShaderNodeBetterCurve);
+		BetterCurveStats::add_monitors();
 	}
 #ifdef TOOLS_ENABLED
 	if (p_level == MODULE_INITIALIZATION_LEVEL_EDITOR) {
@@ -44,4 +64,16 @@ void uninitialize_curvature_module(ModuleInitializationLevel p_level) {
 	if (p_level != MODULE_INITIALIZATION_LEVEL_SCENE) {
 		return;
 	}
+
+	BetterCurveStats::remove_monitors();
+	if (bake_scheduler) {
+		memdelete(bake_scheduler);
+		bake_scheduler = nullptr;
+	}
+	// After the scheduler, whose last bakes may still intern their tables.
+	if (cache_interner) {
+		memdelete(cache_interner);
+		cache_interner = nullptr;
+	}
+	BetterCurve::free_point_property_names();
 }
@@ -0,0 +1,1255 @@
+#ifndef TEST_CURVATURE_H
+#define TEST_CURVATURE_H
+
+#include "../curvature.h"
+#include "../curvature_cache_interner.h"
+#include "../curvature_cursor.h"
+#include "../curvature_evaluator.h"
+#include "../curvature_multi.h"
+#include "../curvature_stats.h"
+
+#include "core/os/os.h"
+#include "core/os/thread.h"
+#include "tests/test_macros.h"
+
+#include <atomic>
+
+namespace TestCurvature {
+
+// Deterministic wavy curve, baked synchronously so that every test sees its bake right away.
+static Ref<BetterCurve> make_curve(int p_point_count, int p_resolution = 100) {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	curve->set_bake_resolution(p_resolution);
+	PackedVector2Array positions;
+	positions.resize(p_point_count);
+	for (int i = 0; i < p_point_count; ++i) {
+		const real_t x = p_point_count > 1 ? i / (real_t)(p_point_count - 1) : 0.0;
+		positions.write[i] = Vector2(x, 0.5 + 0.4 * Math::sin(x * 17.0));
+	}
+	curve->set_points(positions);
+	return curve;
+}
+
+TEST_CASE("[Curvature] Exact sampling goes through the points") {
+	Ref<BetterCurve> curve = make_curve(8);
+	for (int i = 0; i < curve->get_point_count(); ++i) {
+		const Vector2 p = curve->get_point_position(i);
+		CHECK(curve->sample_exact(p.x) == doctest::Approx(p.y));
+	}
+	CHECK(curve->sample_exact(-1.0) == doctest::Approx(curve->get_point_position(0).y));
+	CHECK(curve->sample_exact(2.0) == doctest::Approx(curve->get_point_position(7).y));
+}
+
+TEST_CASE("[Curvature] Segments match the Bezier definition") {
+	Ref<BetterCurve> curve = make_curve(6);
+	BetterCurve::SegmentsRef segments = curve->get_segments();
+	REQUIRE(segments);
+	for (int i = 0; i + 1 < curve->get_point_count(); ++i) {
+		const real_t width = curve->get_point_position(i + 1).x - curve->get_point_position(i).x;
+		for (int k = 0; k <= 10; ++k) {
+			const real_t local = width * k / 10.0;
+			CHECK(segments->evaluate(i, local) == doctest::Approx(curve->sample_local_nocheck(i, local)).epsilon(0.0001));
+		}
+	}
+}
+
+TEST_CASE("[Curvature] Baked sampling follows exact sampling") {
+	Ref<BetterCurve> curve = make_curve(12, 1000);
+	for (int k = 0; k <= 200; ++k) {
+		const real_t x = k / 200.0;
+		CHECK(curve->sample_baked(x) == doctest::Approx(curve->sample_exact(x)).epsilon(0.01));
+	}
+
+	PackedFloat32Array offsets;
+	for (int k = 0; k <= 50; ++k) {
+		offsets.push_back(k / 50.0);
+	}
+	const PackedFloat32Array values = curve->sample_array(offsets);
+	REQUIRE(values.size() == offsets.size());
+	for (int k = 0; k < offsets.size(); ++k) {
+		CHECK(values[k] == doctest::Approx(curve->sample_baked(offsets[k])));
+	}
+}
+
+TEST_CASE("[Curvature] NaN and infinite offsets stay inside the table") {
+	Ref<BetterCurve> curve = make_curve(12, 1000);
+	PackedFloat32Array offsets;
+	offsets.push_back(Math_NAN);
+	offsets.push_back(-Math_INF);
+	offsets.push_back(Math_INF);
+	offsets.push_back(1e30);
+
+	const BetterCurve::BakePrecision precisions[] = { BetterCurve::BAKE_PRECISION_FULL, BetterCurve::BAKE_PRECISION_HALF, BetterCurve::BAKE_PRECISION_UNORM16 };
+	for (BetterCurve::BakePrecision precision : precisions) {
+		curve->set_bake_precision(precision);
+		const real_t first = curve->sample_baked(0);
+		const real_t last = curve->sample_baked(1);
+		const PackedFloat32Array values = curve->sample_array(offsets);
+		REQUIRE(values.size() == offsets.size());
+		// NaN samples the start of the curve.
+		CHECK(values[0] == doctest::Approx(first));
+		CHECK(values[1] == doctest::Approx(first));
+		CHECK(values[2] == doctest::Approx(last));
+		CHECK(values[3] == doctest::Approx(last));
+		CHECK(curve->sample_baked(Math_NAN) == doctest::Approx(first));
+	}
+
+	curve->set_bake_precision(BetterCurve::BAKE_PRECISION_FULL);
+	curve->set_bake_tolerance(0.002);
+	REQUIRE(curve->get_baked_cache()->is_adaptive());
+	const PackedFloat32Array values = curve->sample_array(offsets);
+	CHECK(values[0] == doctest::Approx(curve->sample_baked(0)));
+	CHECK(values[3] == doctest::Approx(curve->sample_baked(1)));
+}
+
+TEST_CASE("[Curvature] get_index() returns the last point at or before the offset") {
+	Ref<BetterCurve> curve = make_curve(33);
+	for (int k = 0; k <= 300; ++k) {
+		const real_t x = k / 300.0;
+		int expected = 0;
+		for (int i = 0; i < curve->get_point_count(); ++i) {
+			if (curve->get_point_position(i).x <= x) {
+				expected = i;
+			}
+		}
+		CHECK(curve->get_index(x) == expected);
+	}
+	CHECK(curve->get_index(-1.0) == 0);
+}
+
+TEST_CASE("[Curvature] Segment lookup grid agrees with a linear scan") {
+	// Clustered offsets, so that some buckets hold many segments and others none.
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	PackedVector2Array positions;
+	for (int i = 0; i < 200; ++i) {
+		const real_t t = i / 199.0;
+		positions.push_back(Vector2(t * t * t, t));
+	}
+	curve->set_points(positions);
+
+	BetterCurve::SegmentsRef segments = curve->get_segments();
+	REQUIRE(segments);
+	REQUIRE(!segments->grid.is_empty());
+	for (int k = 0; k <= 2000; ++k) {
+		const real_t x = k / 2000.0;
+		int expected = 0;
+		for (int i = 0; i < segments->get_count(); ++i) {
+			if (segments->x0[i] <= x) {
+				expected = i;
+			}
+		}
+		CHECK(segments->find(x) == expected);
+	}
+}
+
+TEST_CASE("[Curvature] Linear tangents give linear segments") {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	curve->add_point(Vector2(0, 0));
+	curve->add_point(Vector2(0.5, 0.5));
+	curve->add_point(Vector2(1, 1));
+	curve->set_point_right_mode(0, BetterCurve::TANGENT_LINEAR);
+	curve->set_point_left_mode(1, BetterCurve::TANGENT_LINEAR);
+
+	BetterCurve::SegmentsRef segments = curve->get_segments();
+	REQUIRE(segments);
+	CHECK(segments->kind[0] == BetterCurve::Segments::KIND_LINEAR);
+	CHECK(segments->kind[1] == BetterCurve::Segments::KIND_CUBIC);
+	CHECK(curve->sample_exact(0.25) == doctest::Approx(0.25));
+}
+
+TEST_CASE("[Curvature] clean_dupes() only removes duplicated offsets") {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	curve->add_point(Vector2(0, 0));
+	curve->add_point(Vector2(0.5, 0.5));
+	curve->add_point(Vector2(0.5, 0.7));
+	curve->add_point(Vector2(1, 1));
+
+	curve->clean_dupes();
+	REQUIRE(curve->get_point_count() == 3);
+	CHECK(curve->get_point_position(0).x == doctest::Approx(0.0));
+	CHECK(curve->get_point_position(1).x == doctest::Approx(0.5));
+	CHECK(curve->get_point_position(2).x == doctest::Approx(1.0));
+
+	curve->clean_dupes();
+	CHECK(curve->get_point_count() == 3);
+}
+
+TEST_CASE("[Curvature] Point properties") {
+	Ref<BetterCurve> curve = make_curve(4);
+	bool valid = false;
+	curve->set(SNAME("point_1/position"), Vector2(0.4, 0.25), &valid);
+	CHECK(valid);
+	CHECK(curve->get_point_position(1).is_equal_approx(Vector2(0.4, 0.25)));
+	CHECK(Vector2(curve->get(SNAME("point_1/position"), &valid)).is_equal_approx(Vector2(0.4, 0.25)));
+	CHECK(valid);
+
+	curve->set(SNAME("point_2/right_mode"), BetterCurve::TANGENT_LINEAR, &valid);
+	CHECK(valid);
+	CHECK(int(curve->get(SNAME("point_2/right_mode"))) == BetterCurve::TANGENT_LINEAR);
+
+	// Moving a point past its neighbour sets the value on the point where it ended up.
+	const Vector2 neighbour = curve->get_point_position(2);
+	curve->set(SNAME("point_1/position"), Vector2(0.8, 0.1), &valid);
+	CHECK(valid);
+	CHECK(curve->get_point_position(1).is_equal_approx(neighbour));
+	CHECK(curve->get_point_position(2).is_equal_approx(Vector2(0.8, 0.1)));
+
+	ERR_PRINT_OFF;
+	curve->get(SNAME("point_9/position"), &valid);
+	CHECK_FALSE(valid);
+	curve->get(SNAME("point_/position"), &valid);
+	CHECK_FALSE(valid);
+	ERR_PRINT_ON;
+
+	List<PropertyInfo> properties;
+	curve->get_property_list(&properties);
+	int point_properties = 0;
+	for (const PropertyInfo &property : properties) {
+		if (property.name.begins_with("point_")) {
+			++point_properties;
+		}
+	}
+	// Position for every point, and the tangent and mode of each side that has a neighbour.
+	CHECK(point_properties == 4 + 2 * 2 * 3);
+}
+
+TEST_CASE("[Curvature] Evaluator writes at the stride and offset") {
+	Ref<BetterCurve> a = make_curve(5);
+	Ref<BetterCurve> b = make_curve(9);
+	TypedArray<BetterCurve> curves;
+	curves.push_back(a);
+	curves.push_back(b);
+
+	Ref<BetterCurveEvaluator> evaluator;
+	evaluator.instantiate();
+	evaluator->set_curves(curves);
+	evaluator->set_stride(4);
+	evaluator->set_offset(1);
+
+	// Enough instances to go through the thread pool.
+	const int count = BetterCurveEvaluator::INSTANCES_PER_TASK * 3 + 17;
+	PackedFloat32Array offsets;
+	offsets.resize(count);
+	for (int i = 0; i < count; ++i) {
+		offsets.write[i] = i / (float)(count - 1);
+	}
+	PackedFloat32Array buffer;
+	buffer.resize(count * 4);
+	buffer.fill(-1.0);
+
+	buffer = evaluator->evaluate(offsets, buffer);
+	REQUIRE(buffer.size() == count * 4);
+	for (int i = 0; i < count; i += 97) {
+		CHECK(buffer[i * 4] == -1.0);
+		CHECK(buffer[i * 4 + 1] == doctest::Approx(a->sample_baked(offsets[i])));
+		CHECK(buffer[i * 4 + 2] == doctest::Approx(b->sample_baked(offsets[i])));
+		CHECK(buffer[i * 4 + 3] == -1.0);
+	}
+}
+
+// Points away from both ends of the domain, a jump, and both tangent modes.
+static Ref<BetterCurve> make_edge_curve(int p_resolution = 100) {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	curve->set_bake_resolution(p_resolution);
+	curve->add_point(Vector2(0.2, 0.1), 0.0, 2.0);
+	curve->add_point(Vector2(0.35, 0.8), -1.0, 1.5);
+	curve->add_point(Vector2(0.5, 0.3));
+	curve->add_point(Vector2(0.5, 0.6));
+	curve->add_point(Vector2(0.7, 0.9), 0.0, 0.0, BetterCurve::TANGENT_LINEAR, BetterCurve::TANGENT_FREE);
+	curve->add_point(Vector2(0.8, 0.2), 3.0, 0.0, BetterCurve::TANGENT_FREE, BetterCurve::TANGENT_LINEAR);
+	return curve;
+}
+
+// Same points, baked from scratch.
+static Ref<BetterCurve> make_reference(const Ref<BetterCurve> &p_curve) {
+	Ref<BetterCurve> reference;
+	reference.instantiate();
+	reference->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	reference->set_bake_resolution(p_curve->get_bake_resolution());
+	reference->set_bake_tolerance(p_curve->get_bake_tolerance());
+	reference->set_min_value(p_curve->get_min_value());
+	reference->set_max_value(p_curve->get_max_value());
+	reference->set_bake_precision(p_curve->get_bake_precision());
+	reference->set_data(p_curve->get_data());
+	return reference;
+}
+
+// Brute force: a linear scan for the segment, then the Bézier definition, without going through the segments.
+static real_t sample_reference(const Ref<BetterCurve> &p_curve, real_t p_offset) {
+	const int count = p_curve->get_point_count();
+	if (count == 0) {
+		return 0;
+	}
+	if (p_offset < p_curve->get_point_position(0).x) {
+		return p_curve->get_point_position(0).y;
+	}
+	int i = 0;
+	while (i + 1 < count && p_curve->get_point_position(i + 1).x <= p_offset) {
+		++i;
+	}
+	if (i + 1 == count) {
+		return p_curve->get_point_position(i).y;
+	}
+	return p_curve->sample_local_nocheck(i, p_offset - p_curve->get_point_position(i).x);
+}
+
+static void check_same_points(const Ref<BetterCurve> &p_a, const Ref<BetterCurve> &p_b) {
+	REQUIRE(p_a->get_point_count() == p_b->get_point_count());
+	for (int i = 0; i < p_a->get_point_count(); ++i) {
+		const BetterCurve::Point a = p_a->get_point(i);
+		const BetterCurve::Point b = p_b->get_point(i);
+		CHECK(a.position == b.position);
+		CHECK(a.left_tangent == b.left_tangent);
+		CHECK(a.right_tangent == b.right_tangent);
+		CHECK(a.left_mode == b.left_mode);
+		CHECK(a.right_mode == b.right_mode);
+	}
+}
+
+TEST_CASE("[Curvature] Curve without points") {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	CHECK(curve->sample_exact(0.5) == 0.0);
+	CHECK(curve->sample_baked(0.5) == 0.0);
+	CHECK(curve->sample_derivative(0.5) == 0.0);
+	CHECK(curve->integrate(0.0, 1.0) == 0.0);
+	CHECK(curve->get_range_bounds(0.0, 1.0) == Vector2());
+	CHECK(curve->get_index(0.5) == 0);
+	CHECK(curve->to_shader_function("f").contains("return 0.0;"));
+
+	// Removing the last point goes back to the same state.
+	curve->add_point(Vector2(0.5, 0.7));
+	curve->remove_point(0);
+	CHECK(curve->sample_exact(0.5) == 0.0);
+	CHECK(curve->sample_baked(0.5) == 0.0);
+}
+
+TEST_CASE("[Curvature] Curve with a single point is flat") {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	curve->add_point(Vector2(0.3, 0.7), 5.0, -5.0);
+	const real_t offsets[] = { -1.0, 0.0, 0.3, 0.9, 2.0 };
+	for (real_t x : offsets) {
+		CHECK(curve->sample_exact(x) == doctest::Approx(0.7));
+		CHECK(curve->sample_baked(x) == doctest::Approx(0.7));
+		CHECK(curve->sample_derivative(x) == 0.0);
+	}
+	CHECK(curve->integrate(0.0, 1.0) == doctest::Approx(0.7));
+	CHECK(curve->get_range_bounds(0.0, 1.0).is_equal_approx(Vector2(0.7, 0.7)));
+}
+
+TEST_CASE("[Curvature] Flat outside of the points, and jumps at duplicate offsets") {
+	Ref<BetterCurve> curve = make_edge_curve(1001);
+
+	// Flat before the first point and after the last one, for every way of sampling.
+	const real_t before[] = { -0.5, 0.0, 0.1, 0.2 };
+	for (real_t x : before) {
+		CHECK(curve->sample_exact(x) == doctest::Approx(0.1));
+		CHECK(curve->sample_baked(x) == doctest::Approx(0.1));
+	}
+	const real_t after[] = { 0.8, 0.9, 1.0, 1.5 };
+	for (real_t x : after) {
+		CHECK(curve->sample_exact(x) == doctest::Approx(0.2));
+		CHECK(curve->sample_baked(x) == doctest::Approx(0.2));
+	}
+	CHECK(curve->sample_derivative(0.1) == 0.0);
+	CHECK(curve->sample_derivative(0.9) == 0.0);
+
+	// The last of the duplicated points wins from its offset on.
+	CHECK(curve->sample_exact(0.5 - 1e-4) == doctest::Approx(0.3).epsilon(0.01));
+	CHECK(curve->sample_exact(0.5) == doctest::Approx(0.6));
+
+	for (int k = 0; k <= 1000; ++k) {
+		const real_t x = k / 1000.0;
+		CHECK(curve->sample_exact(x) == doctest::Approx(sample_reference(curve, x)).epsilon(0.0001));
+	}
+}
+
+TEST_CASE("[Curvature] Cursor samples like sample_exact() in any direction") {
+	Ref<BetterCurve> curve = make_edge_curve();
+	Ref<BetterCurveCursor> cursor;
+	cursor.instantiate();
+	cursor->set_curve(curve);
+
+	for (int k = 0; k <= 500; ++k) {
+		CHECK(cursor->sample(k / 500.0) == doctest::Approx(curve->sample_exact(k / 500.0)));
+	}
+	for (int k = 500; k >= 0; --k) {
+		CHECK(cursor->sample(k / 500.0) == doctest::Approx(curve->sample_exact(k / 500.0)));
+	}
+	// Jumps past MAX_WALK segments, and out of the domain.
+	const real_t jumps[] = { 0.9, 0.05, 0.5, -1.0, 0.36, 2.0, 0.21 };
+	for (real_t x : jumps) {
+		CHECK(cursor->sample(x) == doctest::Approx(curve->sample_exact(x)));
+	}
+
+	// Edits are picked up without a reset.
+	curve->set_point_value(1, 0.2);
+	CHECK(cursor->sample(0.35) == doctest::Approx(0.2));
+}
+
+TEST_CASE("[Curvature] Adaptive bake stays within the tolerance") {
+	Ref<BetterCurve> curve = make_curve(12);
+	const real_t tolerance = 0.001;
+	curve->set_bake_tolerance(tolerance);
+	BetterCurve::BakedCacheRef cache = curve->get_baked_cache();
+	REQUIRE(cache);
+	CHECK(cache->is_adaptive());
+	for (int k = 0; k <= 4000; ++k) {
+		const real_t x = k / 4000.0;
+		CHECK(Math::abs(curve->sample_baked(x) - curve->sample_exact(x)) <= tolerance * 1.01);
+	}
+
+	// Jumps are kept as two values at the same offset, not smoothed over.
+	Ref<BetterCurve> edge = make_edge_curve();
+	edge->set_bake_tolerance(tolerance);
+	for (int k = 0; k <= 4000; ++k) {
+		const real_t x = k / 4000.0;
+		CHECK(Math::abs(edge->sample_baked(x) - edge->sample_exact(x)) <= tolerance * 1.01);
+	}
+}
+
+TEST_CASE("[Curvature] Incremental re-bakes match a full bake bit for bit") {
+	const BetterCurve::BakePrecision precisions[] = { BetterCurve::BAKE_PRECISION_FULL, BetterCurve::BAKE_PRECISION_HALF, BetterCurve::BAKE_PRECISION_UNORM16 };
+	for (BetterCurve::BakePrecision precision : precisions) {
+		Ref<BetterCurve> curve = make_edge_curve(1000);
+		curve->set_min_value(-1.0);
+		curve->set_max_value(2.0);
+		curve->set_bake_precision(precision);
+
+		// Each of these only patches the part of the table around the point.
+		curve->set_point_value(2, 0.45);
+		curve->set_point_offset(1, 0.42);
+		curve->set_point_right_tangent(4, -2.0);
+		curve->set_point_left_mode(5, BetterCurve::TANGENT_LINEAR);
+		curve->add_point(Vector2(0.95, 0.5));
+		curve->remove_point(0);
+
+		Ref<BetterCurve> reference = make_reference(curve);
+		BetterCurve::BakedCacheRef patched = curve->get_baked_cache();
+		BetterCurve::BakedCacheRef full = reference->get_baked_cache();
+		REQUIRE(patched);
+		REQUIRE(full);
+		CHECK(patched->precision == precision);
+		CHECK(patched->values == full->values);
+		CHECK(patched->quantized == full->quantized);
+		CHECK(patched->scale == full->scale);
+		CHECK(patched->bias == full->bias);
+	}
+}
+
+TEST_CASE("[Curvature] Reduced precision tables") {
+	Ref<BetterCurve> curve = make_edge_curve(257);
+	curve->set_point_value(4, 2.5);
+	curve->set_min_value(-1.0);
+	curve->set_max_value(2.0);
+	Ref<BetterCurve> full = make_reference(curve);
+
+	curve->set_bake_precision(BetterCurve::BAKE_PRECISION_HALF);
+	BetterCurve::BakedCacheRef cache = curve->get_baked_cache();
+	REQUIRE(cache);
+	CHECK(cache->values.is_empty());
+	CHECK(cache->get_count() == 257);
+	for (int i = 0; i < 257; ++i) {
+		const real_t x = i / 256.0;
+		const real_t expected = full->sample_baked(x);
+		CHECK(Math::abs(curve->sample_baked(x) - expected) <= Math::abs(expected) / 1024.0 + 1e-4);
+	}
+
+	// Normalized to [min_value, max_value], values above are clamped to the maximum.
+	curve->set_bake_precision(BetterCurve::BAKE_PRECISION_UNORM16);
+	const real_t step = 3.0 / UINT16_MAX;
+	for (int i = 0; i < 257; ++i) {
+		const real_t x = i / 256.0;
+		const real_t expected = CLAMP(full->sample_baked(x), (real_t)-1.0, (real_t)2.0);
+		CHECK(Math::abs(curve->sample_baked(x) - expected) <= step);
+	}
+	CHECK(curve->sample_baked(0.7) == doctest::Approx(2.0));
+
+	// A wider range re-encodes the table, and the clamped value comes back.
+	curve->set_max_value(3.0);
+	CHECK(Math::abs(curve->sample_baked(0.7) - full->sample_baked(0.7)) <= 4.0 / UINT16_MAX);
+	CHECK(curve->get_baked_cache()->bias == doctest::Approx(-1.0));
+}
+
+TEST_CASE("[Curvature] Packed data round trip") {
+	Ref<BetterCurve> curve = make_edge_curve(333);
+	curve->set_store_baked_cache(true);
+	const PackedByteArray data = curve->get_packed_data();
+
+	// With the same bake settings, the stored table is used as is, without baking.
+	Ref<BetterCurve> loaded;
+	loaded.instantiate();
+	loaded->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	loaded->set_bake_resolution(333);
+	const uint64_t bakes = loaded->get_bake_count();
+	loaded->set_packed_data(data);
+	CHECK(loaded->get_bake_count() == bakes);
+	check_same_points(curve, loaded);
+	REQUIRE(loaded->get_baked_cache());
+	CHECK(loaded->get_baked_cache()->values == make_reference(curve)->get_baked_cache()->values);
+
+	// A table baked with other settings is dropped, and the curve bakes its own.
+	Ref<BetterCurve> other;
+	other.instantiate();
+	other->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	other->set_bake_resolution(50);
+	other->set_packed_data(data);
+	check_same_points(curve, other);
+	REQUIRE(other->get_baked_cache());
+	CHECK(other->get_baked_cache()->values.size() == 50);
+	CHECK(other->get_baked_cache()->values == make_reference(other)->get_baked_cache()->values);
+
+	// Adaptive tables keep their offsets and index.
+	curve->set_bake_tolerance(0.002);
+	Ref<BetterCurve> adaptive;
+	adaptive.instantiate();
+	adaptive->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	adaptive->set_bake_tolerance(0.002);
+	adaptive->set_packed_data(curve->get_packed_data());
+	BetterCurve::BakedCacheRef stored = curve->get_baked_cache();
+	BetterCurve::BakedCacheRef restored = adaptive->get_baked_cache();
+	REQUIRE(stored);
+	REQUIRE(restored);
+	CHECK(restored->values == stored->values);
+	CHECK(restored->offsets == stored->offsets);
+	CHECK(restored->index == stored->index);
+
+	// Truncated data is rejected and leaves the curve alone.
+	PackedByteArray truncated = data;
+	truncated.resize(data.size() - 3);
+	ERR_PRINT_OFF;
+	loaded->set_packed_data(truncated);
+	ERR_PRINT_ON;
+	check_same_points(curve, loaded);
+}
+
+TEST_CASE("[Curvature] Packed data replaces a pending or running bake") {
+	Ref<BetterCurve> source = make_edge_curve(333);
+	source->set_store_baked_cache(true);
+	const PackedByteArray data = source->get_packed_data();
+	const Vector<real_t> expected = make_reference(source)->get_baked_cache()->values;
+
+	// A queued bake of the old points is dropped, not published over the loaded table.
+	Ref<BetterCurve> queued = make_curve(8, 333);
+	queued->set_bake_mode(BetterCurve::BAKE_MODE_ASYNC);
+	queued->set_bake_debounce_ms(60000);
+	queued->set_point_value(3, 0.05);
+	queued->set_packed_data(data);
+	CHECK(queued->wait_for_bake(0));
+	check_same_points(source, queued);
+	REQUIRE(queued->get_baked_cache());
+	CHECK(queued->get_baked_cache()->values == expected);
+
+	// A bake already running finishes before the loaded table is published.
+	for (int i = 0; i < 20; ++i) {
+		Ref<BetterCurve> running = make_curve(64, 333);
+		running->set_bake_mode(BetterCurve::BAKE_MODE_ASYNC);
+		running->set_bake_debounce_ms(0);
+		running->set_point_value(i, 0.05);
+		running->set_packed_data(data);
+		REQUIRE(running->wait_for_bake(5000));
+		REQUIRE(running->get_baked_cache());
+		CHECK(running->get_baked_cache()->values == expected);
+	}
+}
+
+TEST_CASE("[Curvature] Legacy _data arrays still load") {
+	Ref<BetterCurve> curve = make_edge_curve();
+	Ref<BetterCurve> loaded;
+	loaded.instantiate();
+	loaded->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	bool valid = false;
+	loaded->set(SNAME("_data"), curve->get_data(), &valid);
+	CHECK(valid);
+	check_same_points(curve, loaded);
+	for (int k = 0; k <= 100; ++k) {
+		CHECK(loaded->sample_exact(k / 100.0) == curve->sample_exact(k / 100.0));
+	}
+}
+
+TEST_CASE("[Curvature] Transactions result in a single update") {
+	Ref<BetterCurve> curve = make_curve(6);
+	const uint32_t version = curve->get_segments_version();
+	const uint64_t bakes = curve->get_bake_count();
+
+	curve->begin_edit();
+	curve->set_point_value(1, 0.1);
+	curve->set_point_offset(2, 0.45);
+	curve->begin_edit();
+	curve->add_point(Vector2(0.9, 0.3));
+	curve->commit_edit();
+	curve->remove_point(0);
+	// Nothing reaches the segments or the table before the outermost commit.
+	CHECK(curve->get_segments_version() == version);
+	CHECK(curve->get_bake_count() == bakes);
+	curve->commit_edit();
+
+	CHECK(curve->get_segments_version() == version + 1);
+	CHECK(curve->get_bake_count() == bakes + 1);
+	CHECK(curve->get_point_count() == 6);
+	CHECK(curve->get_baked_cache()->values == make_reference(curve)->get_baked_cache()->values);
+
+	// An unmatched commit is an error, and doesn't leave the curve holding back edits.
+	ERR_PRINT_OFF;
+	curve->commit_edit();
+	ERR_PRINT_ON;
+	curve->set_point_value(1, 0.9);
+	CHECK(curve->get_segments_version() == version + 2);
+}
+
+TEST_CASE("[Curvature] set_points() sorts and clamps") {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	PackedVector2Array positions;
+	positions.push_back(Vector2(0.8, 0.1));
+	positions.push_back(Vector2(-0.5, 0.2));
+	positions.push_back(Vector2(0.4, 0.3));
+	PackedFloat32Array left_tangents;
+	left_tangents.push_back(1.0);
+	left_tangents.push_back(2.0);
+	left_tangents.push_back(3.0);
+	PackedInt32Array right_modes;
+	right_modes.push_back(BetterCurve::TANGENT_FREE);
+	right_modes.push_back(BetterCurve::TANGENT_FREE);
+	right_modes.push_back(BetterCurve::TANGENT_LINEAR);
+	curve->set_points(positions, left_tangents, PackedFloat32Array(), PackedInt32Array(), right_modes);
+
+	REQUIRE(curve->get_point_count() == 3);
+	CHECK(curve->get_point_position(0) == Vector2(0.0, 0.2));
+	CHECK(curve->get_point_position(1) == Vector2(0.4, 0.3));
+	CHECK(curve->get_point_position(2) == Vector2(0.8, 0.1));
+	// Tangents and modes move with their point.
+	CHECK(curve->get_point_left_tangent(0) == 2.0);
+	CHECK(curve->get_point_left_tangent(2) == 1.0);
+	CHECK(curve->get_point_right_mode(1) == BetterCurve::TANGENT_LINEAR);
+	CHECK(curve->get_point_right_tangent(1) == doctest::Approx(-0.5));
+
+	// Mismatched arrays are rejected as a whole.
+	PackedFloat32Array too_short;
+	too_short.push_back(0.0);
+	ERR_PRINT_OFF;
+	curve->set_points(positions, too_short);
+	ERR_PRINT_ON;
+	CHECK(curve->get_point_position(0) == Vector2(0.0, 0.2));
+	CHECK(curve->get_point_left_tangent(0) == 2.0);
+}
+
+// Runs the code of to_shader_function() with GLSL semantics, one line at a time.
+struct ShaderCurve {
+	struct Step {
+		real_t edge = 0;
+		real_t k[4] = {};
+		real_t s[2] = {};
+	};
+	real_t k[4] = {};
+	real_t s[2] = {};
+	LocalVector<Step> steps;
+	real_t first_y = 0;
+	real_t first_x = 0;
+	// Curves without segments return a constant.
+	bool constant = false;
+
+	static void parse(const String &p_list, real_t *r_values, int p_count) {
+		const PackedStringArray parts = p_list.get_slice(")", 0).split(",");
+		REQUIRE(parts.size() == p_count);
+		for (int i = 0; i < p_count; ++i) {
+			r_values[i] = parts[i].strip_edges().to_float();
+		}
+	}
+
+	explicit ShaderCurve(const String &p_code) {
+		for (const String &line : p_code.split("\n")) {
+			const String l = line.strip_edges();
+			if (l.begins_with("vec4 k = ")) {
+				parse(l.get_slice("vec4(", 1), k, 4);
+			} else if (l.begins_with("vec2 s = ")) {
+				parse(l.get_slice("vec2(", 1), s, 2);
+			} else if (l.begins_with("m = step(")) {
+				steps.push_back(Step());
+				steps[steps.size() - 1].edge = l.get_slice("step(", 1).get_slice(",", 0).to_float();
+			} else if (l.begins_with("k = mix(")) {
+				parse(l.get_slice("vec4(", 1), steps[steps.size() - 1].k, 4);
+			} else if (l.begins_with("s = mix(")) {
+				parse(l.get_slice("vec2(", 1), steps[steps.size() - 1].s, 2);
+			} else if (l.begins_with("return mix(")) {
+				first_y = l.get_slice("mix(", 1).get_slice(",", 0).to_float();
+				first_x = l.get_slice("step(x, ", 1).get_slice(")", 0).to_float();
+			} else if (l.begins_with("return ")) {
+				first_y = l.get_slice(" ", 1).get_slice(";", 0).to_float();
+				constant = true;
+			}
+		}
+	}
+
+	real_t evaluate(real_t p_x) const {
+		if (constant) {
+			return first_y;
+		}
+		real_t kk[4] = { k[0], k[1], k[2], k[3] };
+		real_t ss[2] = { s[0], s[1] };
+		for (const Step &step : steps) {
+			// step(edge, x) is 0 below the edge and 1 from it on, so mix() picks the new values.
+			if (p_x >= step.edge) {
+				memcpy(kk, step.k, sizeof(kk));
+				memcpy(ss, step.s, sizeof(ss));
+			}
+		}
+		const real_t t = CLAMP((p_x - ss[0]) * ss[1], (real_t)0, (real_t)1);
+		const real_t y = ((kk[0] * t + kk[1]) * t + kk[2]) * t + kk[3];
+		return p_x <= first_x ? first_y : y;
+	}
+};
+
+TEST_CASE("[Curvature] Shader function evaluates like the segments") {
+	Ref<BetterCurve> curves[] = { make_curve(1), make_curve(2), make_curve(9), make_edge_curve() };
+	for (const Ref<BetterCurve> &curve : curves) {
+		const String code = curve->to_shader_function("curve_value");
+		CHECK(code.begins_with("float curve_value(float x) {"));
+		const ShaderCurve shader(code);
+		CHECK(static_cast<int>(shader.steps.size()) == MAX(curve->get_point_count() - 2, 0));
+		for (int k = -10; k <= 510; ++k) {
+			const real_t x = k / 500.0;
+			CHECK(shader.evaluate(x) == doctest::Approx(curve->sample_exact(x)).epsilon(0.0001));
+		}
+	}
+
+	ERR_PRINT_OFF;
+	CHECK(make_curve(3)->to_shader_function("not valid").is_empty());
+	ERR_PRINT_ON;
+}
+
+TEST_CASE("[Curvature] BetterCurveN samples every channel") {
+	Ref<BetterCurve> x = make_curve(5);
+	Ref<BetterCurve> z = make_edge_curve();
+	Ref<BetterCurveN> multi;
+	multi.instantiate();
+	multi->set_bake_resolution(65);
+	multi->set_channel(0, x);
+	multi->set_channel(2, z);
+
+	for (int i = 0; i < 65; ++i) {
+		const real_t offset = i / 64.0;
+		const Vector4 v = multi->sample(offset);
+		CHECK(v.x == doctest::Approx(x->sample_exact(offset)));
+		CHECK(v.y == 0.0);
+		CHECK(v.z == doctest::Approx(z->sample_exact(offset)));
+		CHECK(v.w == 0.0);
+		CHECK(multi->sample_color(offset).r == doctest::Approx(v.x));
+	}
+
+	// Channel edits rebuild the table, and the same curve can drive several channels.
+	x->set_point_value(2, 0.05);
+	multi->set_channel(3, x);
+	const Vector4 v = multi->sample(0.5);
+	CHECK(v.x == doctest::Approx(0.05));
+	CHECK(v.w == doctest::Approx(0.05));
+	multi->set_channel(0, Ref<BetterCurve>());
+	CHECK(multi->sample(0.5).x == 0.0);
+	CHECK(multi->sample(0.5).w == doctest::Approx(0.05));
+}
+
+TEST_CASE("[Curvature] Interned tables are only shared by identical curves") {
+	BetterCurveCacheInterner *interner = BetterCurveCacheInterner::get_singleton();
+	REQUIRE(interner);
+
+	Ref<BetterCurve> a = make_edge_curve();
+	Ref<BetterCurve> b = make_reference(a);
+	Ref<BetterCurve> nudged = make_reference(a);
+	nudged->set_point_value(3, 0.6 + 1e-6);
+	Ref<BetterCurve> coarse = make_reference(a);
+	coarse->set_bake_resolution(50);
+	Ref<BetterCurve> curves[] = { a, b, nudged, coarse };
+	for (const Ref<BetterCurve> &curve : curves) {
+		curve->set_share_baked_cache(true);
+	}
+
+	CHECK(a->get_baked_cache() == b->get_baked_cache());
+	CHECK(a->get_baked_cache() != nudged->get_baked_cache());
+	CHECK(a->get_baked_cache() != coarse->get_baked_cache());
+	// A shared table is still the one the curve would bake itself.
+	CHECK(nudged->get_baked_cache()->values == make_reference(nudged)->get_baked_cache()->values);
+
+	// Matching goes by content, not by the segments' address.
+	BetterCurve::SegmentsRef copy = std::make_shared<BetterCurve::Segments>(*a->get_segments());
+	const BetterCurveCacheInterner::Key key(copy, 100, 0.0, BetterCurve::BAKE_PRECISION_FULL, a->get_min_value(), a->get_max_value(), false, false);
+	CHECK(interner->find(key) == a->get_baked_cache());
+	const BetterCurveCacheInterner::Key other_key(nudged->get_segments(), 100, 0.0, BetterCurve::BAKE_PRECISION_FULL, nudged->get_min_value(), nudged->get_max_value(), false, false);
+	CHECK(interner->find(other_key) == nudged->get_baked_cache());
+
+	// Tables only live as long as a curve uses them.
+	a.unref();
+	b.unref();
+	curves[0].unref();
+	curves[1].unref();
+	CHECK(interner->find(key) == nullptr);
+}
+
+TEST_CASE("[Curvature] Bake modes") {
+	Ref<BetterCurve> lazy = make_curve(8);
+	lazy->set_bake_mode(BetterCurve::BAKE_MODE_LAZY);
+	uint32_t generation = lazy->get_bake_generation();
+	lazy->set_point_value(3, 0.05);
+	CHECK(lazy->get_bake_generation() == generation);
+	// The first sample bakes, and sees the edit.
+	CHECK(lazy->sample_baked(3 / 7.0) == doctest::Approx(0.05).epsilon(0.01));
+	CHECK(lazy->get_bake_generation() != generation);
+	CHECK(lazy->get_baked_cache()->values == make_reference(lazy)->get_baked_cache()->values);
+
+	// Waiting skips the debounce delay.
+	Ref<BetterCurve> async = make_curve(8);
+	async->set_bake_mode(BetterCurve::BAKE_MODE_ASYNC);
+	async->set_bake_debounce_ms(60000);
+	generation = async->get_bake_generation();
+	async->set_point_value(3, 0.05);
+	CHECK(async->get_bake_generation() == generation);
+	CHECK(async->wait_for_bake(5000));
+	CHECK(async->get_bake_generation() != generation);
+	CHECK(async->get_baked_cache()->values == make_reference(async)->get_baked_cache()->values);
+
+	// A pending bake is handed over when the mode changes.
+	async->set_point_value(4, 0.95);
+	generation = async->get_bake_generation();
+	async->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	CHECK(async->get_bake_generation() != generation);
+	CHECK(async->get_baked_cache()->values == make_reference(async)->get_baked_cache()->values);
+	CHECK(async->wait_for_bake(0));
+}
+
+TEST_CASE("[Curvature] Inverse sampling") {
+	Ref<BetterCurve> curve;
+	curve.instantiate();
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	curve->set_bake_resolution(1000);
+	curve->add_point(Vector2(0.0, 0.1), 0.5, 0.5);
+	curve->add_point(Vector2(0.4, 0.4), 0.8, 0.8);
+	curve->add_point(Vector2(1.0, 0.9), 0.8, 0.8);
+	curve->set_bake_inverse(true);
+	REQUIRE(curve->is_monotone());
+
+	PackedFloat32Array values;
+	for (int k = 0; k <= 200; ++k) {
+		const real_t v = 0.1 + 0.8 * k / 200.0;
+		values.push_back(v);
+		const real_t x = curve->sample_inverse(v);
+		CHECK(curve->sample_exact(x) == doctest::Approx(v).epsilon(0.001));
+
+		// Brute force: the first offset of a fine grid that reaches the value.
+		int first = 0;
+		while (first < 20000 && curve->sample_exact(first / 20000.0) < v) {
+			++first;
+		}
+		CHECK(x == doctest::Approx(first / 20000.0).epsilon(0.002));
+	}
+	const PackedFloat32Array offsets = curve->sample_inverse_array(values);
+	REQUIRE(offsets.size() == values.size());
+	for (int k = 0; k < values.size(); ++k) {
+		CHECK(offsets[k] == doctest::Approx(curve->sample_inverse(values[k])));
+	}
+	// Values outside of the curve's are clamped to the ends.
+	CHECK(curve->sample_inverse(0.0) == doctest::Approx(0.0));
+	CHECK(curve->sample_inverse(1.0) == doctest::Approx(1.0));
+
+	Ref<BetterCurve> wavy = make_curve(8);
+	wavy->set_bake_inverse(true);
+	CHECK_FALSE(wavy->is_monotone());
+	ERR_PRINT_OFF;
+	CHECK(wavy->sample_inverse(0.5) == BetterCurve::MIN_X);
+	ERR_PRINT_ON;
+}
+
+// Simpson's rule over sample_exact(), including the flat parts outside of the points.
+static real_t integrate_reference(const Ref<BetterCurve> &p_curve, real_t p_from, real_t p_to) {
+	const int steps = 20000;
+	const real_t h = (p_to - p_from) / steps;
+	real_t sum = p_curve->sample_exact(p_from) + p_curve->sample_exact(p_to);
+	for (int i = 1; i < steps; ++i) {
+		sum += (i % 2 ? 4 : 2) * p_curve->sample_exact(p_from + i * h);
+	}
+	return sum * h / 3;
+}
+
+TEST_CASE("[Curvature] Derivative and integral") {
+	Ref<BetterCurve> curve = make_edge_curve(1000);
+	const real_t h = 1e-3;
+	const real_t offsets[] = { 0.25, 0.3, 0.41, 0.6, 0.75 };
+	for (real_t x : offsets) {
+		const real_t slope = (curve->sample_exact(x + h) - curve->sample_exact(x - h)) / (2 * h);
+		CHECK(curve->sample_derivative(x) == doctest::Approx(slope).epsilon(0.01));
+	}
+
+	const Vector2 ranges[] = { Vector2(0.0, 1.0), Vector2(0.13, 0.77), Vector2(0.77, 0.13), Vector2(-0.5, 1.5), Vector2(0.36, 0.42), Vector2(0.45, 0.55) };
+	for (const Vector2 &range : ranges) {
+		const real_t expected = integrate_reference(curve, range.x, range.y);
+		CHECK(curve->integrate(range.x, range.y) == doctest::Approx(expected).epsilon(0.001));
+	}
+
+	// The baked table gives the same areas, within its resolution.
+	curve->set_bake_integral(true);
+	REQUIRE(curve->get_baked_cache()->integral_baked);
+	for (const Vector2 &range : ranges) {
+		const real_t expected = integrate_reference(curve, range.x, range.y);
+		CHECK(Math::abs(curve->integrate(range.x, range.y) - expected) <= 0.002);
+	}
+}
+
+TEST_CASE("[Curvature] Range bounds match a brute force search") {
+	Ref<BetterCurve> curve = make_edge_curve();
+	const Vector2 ranges[] = { Vector2(0.0, 1.0), Vector2(0.31, 0.42), Vector2(0.45, 0.55), Vector2(0.55, 0.45), Vector2(-1.0, 0.1), Vector2(0.72, 0.78) };
+	for (const Vector2 &range : ranges) {
+		const real_t from = MIN(range.x, range.y);
+		const real_t to = MAX(range.x, range.y);
+		real_t lo = Math_INF;
+		real_t hi = -Math_INF;
+		for (int k = 0; k <= 20000; ++k) {
+			const real_t y = curve->sample_exact(from + (to - from) * k / 20000.0);
+			lo = MIN(lo, y);
+			hi = MAX(hi, y);
+		}
+		// The bounds are exact, so they contain every sample and are as tight as the grid.
+		const Vector2 bounds = curve->get_range_bounds(range.x, range.y);
+		CHECK(bounds.x <= lo + 1e-5);
+		CHECK(bounds.y >= hi - 1e-5);
+		CHECK(bounds.x == doctest::Approx(lo).epsilon(0.001));
+		CHECK(bounds.y == doctest::Approx(hi).epsilon(0.001));
+	}
+}
+
+TEST_CASE("[Curvature] Bake instrumentation") {
+	const uint64_t module_bakes = BetterCurveStats::get_bake_count();
+	const int64_t live_curves = BetterCurveStats::get_live_curves();
+
+	Ref<BetterCurve> curve = make_curve(8);
+	CHECK(BetterCurveStats::get_live_curves() == live_curves + 1);
+	const uint64_t bakes = curve->get_bake_count();
+	CHECK(bakes > 0);
+	CHECK(curve->get_average_bake_usec() >= 0.0);
+	CHECK(curve->get_baked_cache_memory_usage() >= static_cast<int64_t>(100 * sizeof(real_t)));
+
+	// Lazy edits before a sample all join the same pending bake.
+	curve->set_bake_mode(BetterCurve::BAKE_MODE_LAZY);
+	const uint64_t coalesced = curve->get_coalesced_update_count();
+	const uint64_t baked = curve->get_bake_count();
+	const uint32_t generation = curve->get_bake_generation();
+	for (int i = 0; i < 5; ++i) {
+		curve->set_point_value(1, i * 0.1);
+	}
+	CHECK(curve->get_bake_count() == baked);
+	curve->sample_baked(0.5);
+	CHECK(curve->get_bake_count() == baked + 1);
+	CHECK(curve->get_coalesced_update_count() >= coalesced + 4);
+	CHECK(curve->get_bake_generation() != generation);
+	CHECK(BetterCurveStats::get_bake_count() > module_bakes);
+
+	curve.unref();
+	CHECK(BetterCurveStats::get_live_curves() == live_curves);
+}
+
+// Counts the errors printed while it's alive, from every thread.
+struct ErrorCounter {
+	ErrorHandlerList handler;
+	std::atomic<int> count{ 0 };
+
+	static void _count(void *p_self, const char *p_function, const char *p_file, int p_line, const char *p_error, const char *p_message, bool p_editor_notify, ErrorHandlerType p_type) {
+		static_cast<ErrorCounter *>(p_self)->count.fetch_add(1);
+	}
+
+	ErrorCounter() {
+		handler.errfunc = _count;
+		handler.userdata = this;
+		add_error_handler(&handler);
+	}
+	~ErrorCounter() {
+		remove_error_handler(&handler);
+	}
+};
+
+// The resizer is the only thread removing points, and never goes below this many,
+// so every index below it stays valid for the other writers and no edit is expected to fail.
+static const int STRESS_MIN_POINTS = 8;
+
+struct StressState {
+	Ref<BetterCurve> curve;
+	std::atomic<bool> stop{ false };
+	std::atomic<int> bad_samples{ 0 };
+	std::atomic<int> failed_edits{ 0 };
+	int iterations = 0;
+};
+
+// Point edits, left and right, always at a valid index.
+static void stress_edit_points(void *p_state) {
+	StressState &s = *static_cast<StressState *>(p_state);
+	for (int k = 0; k < s.iterations; ++k) {
+		const int index = k % STRESS_MIN_POINTS;
+		s.curve->set_point_value(index, (k % 10) / 10.0);
+		if (k % 5 == 0 && s.curve->set_point_offset(index, (k % 97) / 97.0) < 0) {
+			s.failed_edits.fetch_add(1);
+		}
+		if (k % 9 == 0) {
+			s.curve->set_point_right_mode(index, k % 2 ? BetterCurve::TANGENT_LINEAR : BetterCurve::TANGENT_FREE);
+			s.curve->set_point_left_tangent(index, 0.5);
+		}
+	}
+}
+
+// Nested transactions, open at the same time as the other threads' edits and transactions.
+static void stress_transactions(void *p_state) {
+	StressState &s = *static_cast<StressState *>(p_state);
+	for (int k = 0; k < s.iterations; ++k) {
+		const int index = (k * 3) % STRESS_MIN_POINTS;
+		s.curve->begin_edit();
+		s.curve->set_point_value(index, (k % 7) / 7.0);
+		s.curve->begin_edit();
+		if (s.curve->set_point_offset(index, (k % 89) / 89.0) < 0) {
+			s.failed_edits.fetch_add(1);
+		}
+		if (k % 4 == 0) {
+			s.curve->add_point(Vector2((k % 100) / 100.0, 0.5));
+		}
+		s.curve->commit_edit();
+		s.curve->set_point_value(index, 1.0 - (k % 7) / 7.0);
+		s.curve->commit_edit();
+	}
+}
+
+// The only thread shrinking the curve.
+static void stress_resize(void *p_state) {
+	StressState &s = *static_cast<StressState *>(p_state);
+	for (int k = 0; k < s.iterations; ++k) {
+		switch (k % 3) {
+			case 0: {
+				s.curve->set_point_count(STRESS_MIN_POINTS + k % 16);
+			} break;
+			case 1: {
+				PackedVector2Array positions;
+				for (int i = STRESS_MIN_POINTS + k % 8; i > 0; --i) {
+					positions.push_back(Vector2(((i * 37 + k) % 101) / 100.0, (i % 5) / 4.0));
+				}
+				s.curve->set_points(positions);
+			} break;
+			default: {
+				// Other threads only add points meanwhile, so both indices stay valid.
+				const int count = s.curve->get_point_count();
+				if (count > STRESS_MIN_POINTS + 1) {
+					s.curve->remove_point(count - 1);
+					s.curve->remove_point(0);
+				}
+			} break;
+		}
+	}
+}
+
+static void stress_read(void *p_state) {
+	StressState &s = *static_cast<StressState *>(p_state);
+	while (!s.stop.load()) {
+		for (int k = 0; k <= 64; ++k) {
+			if (!Math::is_finite(s.curve->sample_baked(k / 64.0))) {
+				s.bad_samples.fetch_add(1);
+			}
+		}
+		// Every published snapshot must be whole: sorted, and with coefficients for each segment.
+		BetterCurve::SegmentsRef segments = s.curve->get_segments();
+		if (!segments || segments->x0.is_empty()) {
+			continue;
+		}
+		const int count = segments->get_count();
+		if (segments->x0.size() != count + 1 || segments->d.size() != count || segments->kind.size() != count) {
+			s.bad_samples.fetch_add(1);
+			continue;
+		}
+		for (int i = 0; i < count; ++i) {
+			if (segments->x0[i] > segments->x0[i + 1]) {
+				s.bad_samples.fetch_add(1);
+			}
+		}
+	}
+}
+
+TEST_CASE("[Curvature][Stress] Concurrent edits, transactions, resizes and samples") {
+	StressState state;
+	state.curve = make_curve(STRESS_MIN_POINTS, 257);
+	state.curve->set_bake_mode(BetterCurve::BAKE_MODE_ASYNC);
+	state.curve->set_bake_debounce_ms(0);
+	state.iterations = 300;
+
+	ErrorCounter errors;
+	LocalVector<Thread *> writers;
+	LocalVector<Thread *> readers;
+	void (*writer_funcs[])(void *) = { stress_edit_points, stress_edit_points, stress_transactions, stress_transactions, stress_resize };
+	for (int i = 0; i < 4; ++i) {
+		readers.push_back(memnew(Thread));
+		readers[i]->start(stress_read, &state);
+	}
+	for (void (*func)(void *) : writer_funcs) {
+		writers.push_back(memnew(Thread));
+		writers[writers.size() - 1]->start(func, &state);
+	}
+
+	for (Thread *thread : writers) {
+		thread->wait_to_finish();
+		memdelete(thread);
+	}
+	state.stop.store(true);
+	for (Thread *thread : readers) {
+		thread->wait_to_finish();
+		memdelete(thread);
+	}
+
+	CHECK(errors.count.load() == 0);
+	CHECK(state.failed_edits.load() == 0);
+	CHECK(state.bad_samples.load() == 0);
+
+	const int point_count = state.curve->get_point_count();
+	REQUIRE(point_count >= STRESS_MIN_POINTS);
+	for (int i = 1; i < point_count; ++i) {
+		CHECK(state.curve->get_point_position(i - 1).x <= state.curve->get_point_position(i).x);
+	}
+
+	// Every transaction was committed, so edits aren't held back anymore.
+	const uint32_t version = state.curve->get_segments_version();
+	state.curve->set_point_value(0, 0.25);
+	CHECK(state.curve->get_segments_version() != version);
+
+	// The final segments and table must be exactly what the final points give from scratch.
+	REQUIRE(state.curve->wait_for_bake(5000));
+	Ref<BetterCurve> reference;
+	reference.instantiate();
+	reference->set_bake_mode(BetterCurve::BAKE_MODE_SYNC);
+	reference->set_bake_resolution(257);
+	reference->set_data(state.curve->get_data());
+
+	BetterCurve::SegmentsRef segments = state.curve->get_segments();
+	BetterCurve::SegmentsRef expected = reference->get_segments();
+	REQUIRE(segments);
+	REQUIRE(expected);
+	CHECK(segments->x0 == expected->x0);
+	CHECK(segments->a == expected->a);
+	CHECK(segments->b == expected->b);
+	CHECK(segments->c == expected->c);
+	CHECK(segments->d == expected->d);
+	CHECK(segments->first_y == expected->first_y);
+	CHECK(segments->last_y == expected->last_y);
+
+	BetterCurve::BakedCacheRef baked = state.curve->get_baked_cache();
+	BetterCurve::BakedCacheRef expected_baked = reference->get_baked_cache();
+	REQUIRE(baked);
+	REQUIRE(expected_baked);
+	CHECK(baked->values == expected_baked->values);
+}
+
+TEST_CASE("[Curvature][Benchmark] Sample throughput by point count and resolution" * doctest::skip()) {
+	const int SAMPLE_COUNT = 1000000;
+	const int point_counts[] = { 4, 64, 1024 };
+	const int resolutions[] = { 32, 256, 1000 };
+	for (int point_count : point_counts) {
+		for (int resolution : resolutions) {
+			Ref<BetterCurve> curve = make_curve(point_count, resolution);
+			real_t sum = 0;
+
+			uint64_t begin = OS::get_singleton()->get_ticks_usec();
+			for (int k = 0; k < SAMPLE_COUNT; ++k) {
+				sum += curve->sample_baked((k % 4096) / 4096.0);
+			}
+			const uint64_t baked_usec = OS::get_singleton()->get_ticks_usec() - begin;
+
+			begin = OS::get_singleton()->get_ticks_usec();
+			for (int k = 0; k < SAMPLE_COUNT; ++k) {
+				sum += curve->sample_exact((k % 4096) / 4096.0);
+			}
+			const uint64_t exact_usec = OS::get_singleton()->get_ticks_usec() - begin;
+
+			MESSAGE(vformat("%d points, resolution %d: sample_baked() %.1f ns, sample_exact() %.1f ns (%f)", point_count, resolution, baked_usec * 1000.0 / SAMPLE_COUNT, exact_usec * 1000.0 / SAMPLE_COUNT, sum));
+		}
+	}
+}
+
+TEST_CASE("[Curvature][Benchmark] Bake latency" * doctest::skip()) {
+	const int REPEAT = 200;
+	const int point_counts[] = { 4, 64, 1024, 8192 };
+	for (int point_count : point_counts) {
+		Ref<BetterCurve> curve = make_curve(point_count, 1000);
+
+		uint64_t begin = OS::get_singleton()->get_ticks_usec();
+		for (int k = 0; k < REPEAT; ++k) {
+			// One point moved, so the partial re-bake is measured.
+			curve->set_point_value(point_count / 2, (k % 10) / 10.0);
+		}
+		const uint64_t edit_usec = OS::get_singleton()->get_ticks_usec() - begin;
+
+		begin = OS::get_singleton()->get_ticks_usec();
+		for (int k = 0; k < REPEAT; ++k) {
+			curve->bake();
+		}
+		const uint64_t bake_usec = OS::get_singleton()->get_ticks_usec() - begin;
+
+		MESSAGE(vformat("%d points: edit and re-bake %.1f us, full bake %.1f us", point_count, edit_usec / (double)REPEAT, bake_usec / (double)REPEAT));
+	}
+}
+
+struct ContentionState {
+	Ref<BetterCurve> curve;
+	std::atomic<bool> stop{ false };
+	std::atomic<uint64_t> samples{ 0 };
+};
+
+TEST_CASE("[Curvature][Benchmark] Reader contention while a writer edits" * doctest::skip()) {
+	const int thread_counts[] = { 1, 4, 16 };
+	const uint64_t DURATION_USEC = 500000;
+	for (int thread_count : thread_counts) {
+		ContentionState state;
+		state.curve = make_curve(256, 1000);
+		state.curve->set_bake_mode(BetterCurve::BAKE_MODE_ASYNC);
+		state.curve->set_bake_debounce_ms(0);
+
+		LocalVector<Thread *> readers;
+		for (int i = 0; i < thread_count; ++i) {
+			Thread *thread = memnew(Thread);
+			thread->start([](void *p_state) {
+				ContentionState &s = *static_cast<ContentionState *>(p_state);
+				uint64_t count = 0;
+				real_t sum = 0;
+				while (!s.stop.load(std::memory_order_relaxed)) {
+					for (int k = 0; k < 1024; ++k) {
+						sum += s.curve->sample_baked(k / 1024.0);
+					}
+					count += 1024;
+				}
+				s.samples.fetch_add(count + (sum > 1e30 ? 1 : 0));
+			},
+					&state);
+			readers.push_back(thread);
+		}
+
+		const uint64_t begin = OS::get_singleton()->get_ticks_usec();
+		int edits = 0;
+		while (OS::get_singleton()->get_ticks_usec() - begin < DURATION_USEC) {
+			state.curve->set_point_value(edits % 256, (edits % 10) / 10.0);
+			++edits;
+			OS::get_singleton()->delay_usec(100);
+		}
+		state.stop.store(true);
+		for (Thread *thread : readers) {
+			thread->wait_to_finish();
+			memdelete(thread);
+		}
+
+		MESSAGE(vformat("%d readers: %.1f M samples/s in total, %d edits", thread_count, state.samples.load() / (double)DURATION_USEC, edits));
+	}
+}
+
+} // namespace TestCurvature
+
+#endif // TEST_CURVATURE_H